@@ -0,0 +1,366 @@
+//! CPU and NUMA affinity of isolate and background threads.
+//!
+//! On hosts with several NUMA nodes, a thread that migrates to another node pays for remote memory
+//! accesses to everything it allocated before.  An affinity [`Policy`](struct.Policy.html) keeps
+//! related work together:
+//!
+//!   * Isolate threads are pinned to cores with `pin_isolate_thread`, which hands out the cores of
+//!     the topology round-robin, one node after the other.  The threads of a
+//!     `worker::WorkerPool` do this automatically.
+//!   * Background tasks that V8 posts from a pinned thread run on a pool of threads pinned to the
+//!     same node, instead of on a fresh thread that could land anywhere.
+//!   * With the default first-touch placement of the kernel, a page of memory lands on the node
+//!     of the thread that first touches it, not of the thread that allocated it.  Large array
+//!     buffers come from fresh, lazily mapped pages even when they are zero-initialized, so they
+//!     end up on the node of whichever thread first writes to each page.
+//!
+//! Without a configured policy, none of this happens.  Pinning is only implemented on Linux; on
+//! other platforms, it succeeds without doing anything.
+use error;
+use std::cell;
+use std::fs;
+use std::io;
+use std::sync;
+
+/// The number of 64-bit words in a CPU mask, enough for the 1024 CPUs of the default glibc
+/// `cpu_set_t`.
+#[cfg(target_os = "linux")]
+const CPU_MASK_WORDS: usize = 16;
+
+lazy_static! {
+    static ref POLICY: sync::Mutex<Option<sync::Arc<Policy>>> = sync::Mutex::new(None);
+}
+
+thread_local! {
+    static CURRENT_NODE: cell::Cell<Option<usize>> = cell::Cell::new(None);
+}
+
+/// The NUMA nodes of a host and the CPUs that belong to each of them.
+#[derive(Clone, Debug, Eq, PartialEq)]
+pub struct Topology {
+    nodes: Vec<Node>,
+}
+
+/// A NUMA node.
+#[derive(Clone, Debug, Eq, PartialEq)]
+pub struct Node {
+    id: usize,
+    cpus: Vec<usize>,
+}
+
+/// Where isolate threads and background tasks are placed.
+#[derive(Debug)]
+pub struct Policy {
+    topology: Topology,
+    node_local_background_tasks: bool,
+    next_cpu: sync::atomic::AtomicUsize,
+}
+
+impl Topology {
+    /// Detects the topology of the host, limited to the CPUs that the current thread is allowed to
+    /// run on, so that pinning to any of them succeeds under a restricted cpuset.
+    ///
+    /// Falls back to a single node with all allowed CPUs where the topology can't be read, which
+    /// includes all platforms other than Linux.
+    pub fn detect() -> Topology {
+        let allowed = allowed_cpus();
+        let topology = Topology::read_sysfs().unwrap_or_else(|_| match allowed {
+            Some(ref cpus) => Topology::from_nodes(vec![cpus.clone()]),
+            None => Topology::single_node(::num_cpus::get()),
+        });
+
+        match allowed {
+            Some(ref cpus) => topology.restrict(cpus),
+            None => topology,
+        }
+    }
+
+    /// A topology with a single node of the specified number of CPUs, as on most hosts.
+    pub fn single_node(cpus: usize) -> Topology {
+        Topology::from_nodes(vec![(0..cpus).collect()])
+    }
+
+    /// A topology with the specified CPUs on each node.  Empty nodes are left out.
+    pub fn from_nodes(nodes: Vec<Vec<usize>>) -> Topology {
+        Topology {
+            nodes: nodes.into_iter()
+                .enumerate()
+                .filter(|&(_, ref cpus)| !cpus.is_empty())
+                .map(|(id, cpus)| {
+                    Node {
+                        id: id,
+                        cpus: cpus,
+                    }
+                })
+                .collect(),
+        }
+    }
+
+    /// The nodes of the topology.
+    pub fn nodes(&self) -> &[Node] {
+        &self.nodes
+    }
+
+    /// Returns the node with the specified id.
+    pub fn node(&self, id: usize) -> Option<&Node> {
+        self.nodes.iter().find(|node| node.id == id)
+    }
+
+    /// Returns the node that the specified CPU belongs to.
+    pub fn node_of_cpu(&self, cpu: usize) -> Option<&Node> {
+        self.nodes.iter().find(|node| node.cpus.contains(&cpu))
+    }
+
+    /// The total number of CPUs.
+    pub fn cpu_count(&self) -> usize {
+        self.nodes.iter().map(|node| node.cpus.len()).sum()
+    }
+
+    /// Leaves out the CPUs that are not in the specified list, and the nodes that become empty.
+    fn restrict(self, cpus: &[usize]) -> Topology {
+        Topology {
+            nodes: self.nodes
+                .into_iter()
+                .map(|node| {
+                    Node {
+                        id: node.id,
+                        cpus: node.cpus.into_iter().filter(|cpu| cpus.contains(cpu)).collect(),
+                    }
+                })
+                .filter(|node| !node.cpus.is_empty())
+                .collect(),
+        }
+    }
+
+    fn read_sysfs() -> io::Result<Topology> {
+        let mut nodes = Vec::new();
+
+        for entry in try!(fs::read_dir("/sys/devices/system/node")) {
+            let entry = try!(entry);
+            let name = entry.file_name().to_string_lossy().into_owned();
+
+            let id = match name.trim_left_matches("node").parse::<usize>() {
+                Ok(id) if name.starts_with("node") => id,
+                _ => continue,
+            };
+
+            let mut cpulist = String::new();
+            try!(io::Read::read_to_string(&mut try!(fs::File::open(entry.path().join("cpulist"))),
+                                          &mut cpulist));
+
+            match parse_cpu_list(cpulist.trim()) {
+                Some(cpus) => {
+                    if !cpus.is_empty() {
+                        nodes.push(Node {
+                            id: id,
+                            cpus: cpus,
+                        })
+                    }
+                }
+                None => return Err(io::Error::new(io::ErrorKind::InvalidData, "bad cpulist")),
+            }
+        }
+
+        if nodes.is_empty() {
+            return Err(io::Error::new(io::ErrorKind::NotFound, "no NUMA nodes"));
+        }
+
+        nodes.sort_by_key(|node| node.id);
+        Ok(Topology { nodes: nodes })
+    }
+}
+
+impl Node {
+    /// The id of the node.
+    pub fn id(&self) -> usize {
+        self.id
+    }
+
+    /// The CPUs that belong to the node.
+    pub fn cpus(&self) -> &[usize] {
+        &self.cpus
+    }
+}
+
+impl Policy {
+    /// Creates a policy for the specified topology, that keeps background tasks on the node of
+    /// the thread that posts them.
+    pub fn new(topology: Topology) -> Policy {
+        Policy {
+            topology: topology,
+            node_local_background_tasks: true,
+            next_cpu: sync::atomic::AtomicUsize::new(0),
+        }
+    }
+
+    /// Whether background tasks posted from a pinned thread run on threads of the same node.
+    pub fn node_local_background_tasks(mut self, value: bool) -> Policy {
+        self.node_local_background_tasks = value;
+        self
+    }
+
+    /// The topology that the policy places threads on.
+    pub fn topology(&self) -> &Topology {
+        &self.topology
+    }
+
+    /// Returns the CPU that the next isolate thread should be pinned to.
+    ///
+    /// CPUs are handed out node by node, so that the first isolates share a node.
+    fn next_cpu(&self) -> Option<usize> {
+        let count = self.topology.cpu_count();
+
+        if count == 0 {
+            return None;
+        }
+
+        let index = self.next_cpu.fetch_add(1, sync::atomic::Ordering::SeqCst) % count;
+        self.topology.nodes.iter().flat_map(|node| node.cpus.iter().cloned()).nth(index)
+    }
+}
+
+/// Sets the affinity policy for threads that are pinned from now on.
+pub fn configure(policy: Policy) {
+    *POLICY.lock().unwrap() = Some(sync::Arc::new(policy));
+}
+
+/// Returns the configured affinity policy, if any.
+pub fn policy() -> Option<sync::Arc<Policy>> {
+    POLICY.lock().unwrap().clone()
+}
+
+/// Pins the current thread to the next core of the configured policy, returning that core.
+///
+/// Does nothing and returns `None` if no policy is configured.
+pub fn pin_isolate_thread() -> error::Result<Option<usize>> {
+    let policy = match policy() {
+        Some(policy) => policy,
+        None => return Ok(None),
+    };
+
+    match policy.next_cpu() {
+        Some(cpu) => {
+            let node = policy.topology.node_of_cpu(cpu).map(|node| node.id);
+            try!(pin_current_thread(&[cpu]));
+            CURRENT_NODE.with(|current| current.set(node));
+            Ok(Some(cpu))
+        }
+        None => Ok(None),
+    }
+}
+
+/// Pins the current thread to the CPUs of the specified node of the configured policy.
+pub fn pin_to_node(node: usize) -> error::Result<()> {
+    let cpus = match policy().and_then(|p| p.topology.node(node).map(|n| n.cpus.clone())) {
+        Some(cpus) => cpus,
+        None => return Err(format!("there is no NUMA node {} in the affinity policy", node).into()),
+    };
+
+    try!(pin_current_thread(&cpus));
+    CURRENT_NODE.with(|current| current.set(Some(node)));
+    Ok(())
+}
+
+/// The node that the current thread has been pinned to, if any.
+pub fn current_node() -> Option<usize> {
+    CURRENT_NODE.with(|current| current.get())
+}
+
+/// Returns the node and its CPUs that a background task posted from the current thread should run
+/// on, if the configured policy keeps background tasks node-local.
+pub fn background_node() -> Option<(usize, Vec<usize>)> {
+    let node = match current_node() {
+        Some(node) => node,
+        None => return None,
+    };
+
+    policy()
+        .and_then(|policy| if policy.node_local_background_tasks {
+            policy.topology.node(node).map(|n| (n.id, n.cpus.clone()))
+        } else {
+            None
+        })
+}
+
+/// Parses a Linux CPU list such as `0-3,8,10-11`.
+fn parse_cpu_list(list: &str) -> Option<Vec<usize>> {
+    let mut cpus = Vec::new();
+
+    if list.is_empty() {
+        return Some(cpus);
+    }
+
+    for range in list.split(',') {
+        let mut bounds = range.splitn(2, '-');
+        let start = match bounds.next().and_then(|b| b.trim().parse().ok()) {
+            Some(start) => start,
+            None => return None,
+        };
+        let end = match bounds.next() {
+            Some(end) => {
+                match end.trim().parse().ok() {
+                    Some(end) => end,
+                    None => return None,
+                }
+            }
+            None => start,
+        };
+
+        cpus.extend(start..end + 1);
+    }
+
+    Some(cpus)
+}
+
+#[cfg(target_os = "linux")]
+fn allowed_cpus() -> Option<Vec<usize>> {
+    extern "C" {
+        fn sched_getaffinity(pid: i32, size: usize, mask: *mut u64) -> i32;
+    }
+
+    let mut mask = [0u64; CPU_MASK_WORDS];
+
+    // A pid of 0 means the calling thread
+    if unsafe { sched_getaffinity(0, CPU_MASK_WORDS * 8, mask.as_mut_ptr()) } != 0 {
+        return None;
+    }
+
+    Some((0..CPU_MASK_WORDS * 64).filter(|&cpu| mask[cpu / 64] & (1 << (cpu % 64)) != 0).collect())
+}
+
+#[cfg(not(target_os = "linux"))]
+fn allowed_cpus() -> Option<Vec<usize>> {
+    None
+}
+
+#[cfg(target_os = "linux")]
+fn pin_current_thread(cpus: &[usize]) -> error::Result<()> {
+    extern "C" {
+        fn sched_setaffinity(pid: i32, size: usize, mask: *const u64) -> i32;
+    }
+
+    let mut mask = [0u64; CPU_MASK_WORDS];
+
+    for &cpu in cpus {
+        if cpu >= CPU_MASK_WORDS * 64 {
+            return Err(format!("CPU {} is out of range", cpu).into());
+        }
+        mask[cpu / 64] |= 1 << (cpu % 64);
+    }
+
+    // A pid of 0 means the calling thread
+    if unsafe { sched_setaffinity(0, CPU_MASK_WORDS * 8, mask.as_ptr()) } != 0 {
+        return Err(format!("could not pin thread to CPUs {:?}: {}",
+                           cpus,
+                           io::Error::last_os_error())
+            .into());
+    }
+
+    Ok(())
+}
+
+#[cfg(not(target_os = "linux"))]
+fn pin_current_thread(_cpus: &[usize]) -> error::Result<()> {
+    Ok(())
+}
+
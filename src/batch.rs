@@ -0,0 +1,194 @@
+//! Running many small scripts or functions in a single call.
+//!
+//! Running a compiled script or calling a function from Rust takes a call into V8, with its own
+//! scopes and exception handling, and returns the result as a handle that has to be converted by
+//! yet another call.  For workloads that evaluate many tiny snippets, such as the rules of a rule
+//! engine, that overhead dominates.  [`run`](fn.run.html) instead evaluates a whole list of tasks
+//! in one call, converts every result to the requested primitive type inside V8, and returns them
+//! in a packed buffer.
+use v8_sys as v8;
+use context;
+use isolate;
+use script;
+use util;
+use value;
+use std::os;
+use std::ptr;
+use std::slice;
+
+/// A task to run as part of a batch.
+#[derive(Clone, Copy, Debug)]
+pub enum Task<'a> {
+    /// Runs a compiled script.
+    Script(&'a script::Script),
+    /// Calls a function, with `undefined` as the receiver and the arguments of the batch.
+    Function(&'a value::Function),
+}
+
+/// How the result of each task of a batch should be converted.
+#[derive(Clone, Copy, Debug, Eq, PartialEq)]
+pub enum Output {
+    /// The results are discarded; only whether a task threw is recorded.
+    Discard,
+    /// The results are converted to booleans, as if by `Boolean(result)`.
+    Boolean,
+    /// The results are converted to numbers, as if by `Number(result)`.
+    Number,
+    /// The results are converted to strings, as if by `String(result)`.
+    String,
+}
+
+/// The result of a single task of a batch.
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub enum Item<'a> {
+    /// The result was discarded.
+    Discarded,
+    Boolean(bool),
+    Number(f64),
+    String(&'a str),
+}
+
+/// The results of a batch.
+pub struct Results {
+    output: Output,
+    results: Vec<v8::BatchResult>,
+    exceptions: Vec<Option<value::Value>>,
+    strings: String,
+}
+
+/// Runs all of the specified tasks in the specified context, in order, with a single call into V8.
+///
+/// Functions are called with the specified arguments.  A task that throws does not stop the batch;
+/// its exception is recorded in its result instead.  If execution is terminated, the remaining
+/// tasks are not run, and the results only cover the tasks that were.  A task that fails without
+/// throwing, which happens while execution is being terminated, reports `undefined` as exception.
+pub fn run(isolate: &isolate::Isolate,
+           context: &context::Context,
+           tasks: &[Task],
+           args: &[&value::Value],
+           output: Output)
+           -> Results {
+    let raw_tasks = tasks.iter()
+        .map(|task| match *task {
+            Task::Script(script) => {
+                v8::BatchTask {
+                    script: script.as_raw(),
+                    function: ptr::null_mut(),
+                }
+            }
+            Task::Function(function) => {
+                v8::BatchTask {
+                    script: ptr::null_mut(),
+                    function: function.as_raw(),
+                }
+            }
+        })
+        .collect::<Vec<_>>();
+    let mut arg_ptrs = args.iter().map(|v| v.as_raw()).collect::<Vec<_>>();
+    let mut results: Vec<v8::BatchResult> = Vec::with_capacity(tasks.len());
+    let mut strings: Vec<u8> = Vec::new();
+
+    let raw_output = match output {
+        Output::Discard => v8::BatchOutput::BatchOutput_Discard,
+        Output::Boolean => v8::BatchOutput::BatchOutput_Boolean,
+        Output::Number => v8::BatchOutput::BatchOutput_Number,
+        Output::String => v8::BatchOutput::BatchOutput_String,
+    };
+
+    unsafe {
+        let count = util::invoke_ctx(isolate, context, |c| {
+                v8::v8_Batch_Run(c,
+                                 context.as_raw(),
+                                 raw_tasks.len() as os::raw::c_int,
+                                 raw_tasks.as_ptr(),
+                                 arg_ptrs.len() as os::raw::c_int,
+                                 arg_ptrs.as_mut_ptr(),
+                                 raw_output,
+                                 results.as_mut_ptr(),
+                                 Some(append_string),
+                                 &mut strings as *mut Vec<u8> as *mut os::raw::c_void)
+            })
+            .unwrap();
+        results.set_len(count as usize);
+    }
+
+    let exceptions = results.iter()
+        .map(|result| if result.exception.is_null() {
+            None
+        } else {
+            let exception = unsafe { value::Value::from_raw(isolate, result.exception) };
+            util::resume_panic(isolate, context, &exception);
+            Some(exception)
+        })
+        .collect();
+
+    Results {
+        output: output,
+        results: results,
+        exceptions: exceptions,
+        // V8 always produces valid UTF-8
+        strings: unsafe { String::from_utf8_unchecked(strings) },
+    }
+}
+
+impl Results {
+    /// The number of tasks that were run.
+    pub fn len(&self) -> usize {
+        self.results.len()
+    }
+
+    /// Whether no tasks were run.
+    pub fn is_empty(&self) -> bool {
+        self.results.is_empty()
+    }
+
+    /// Returns the result of the task at the specified index, or the exception that it threw.
+    ///
+    /// Panics if the index is out of bounds.
+    pub fn get(&self, index: usize) -> Result<Item, &value::Value> {
+        if let Some(ref exception) = self.exceptions[index] {
+            return Err(exception);
+        }
+
+        let result = &self.results[index];
+
+        Ok(match self.output {
+            Output::Discard => Item::Discarded,
+            Output::Boolean => Item::Boolean(result.boolean),
+            Output::Number => Item::Number(result.number),
+            Output::String => {
+                let start = result.string_offset as usize;
+                Item::String(&self.strings[start..start + result.string_length as usize])
+            }
+        })
+    }
+
+    /// Returns an iterator over the results of all tasks that were run.
+    pub fn iter(&self) -> ResultsIter {
+        ResultsIter {
+            results: self,
+            indices: 0..self.len(),
+        }
+    }
+}
+
+/// An iterator over the results of a batch.
+pub struct ResultsIter<'a> {
+    results: &'a Results,
+    indices: ::std::ops::Range<usize>,
+}
+
+impl<'a> Iterator for ResultsIter<'a> {
+    type Item = Result<Item<'a>, &'a value::Value>;
+
+    fn next(&mut self) -> Option<Result<Item<'a>, &'a value::Value>> {
+        self.indices.next().map(|index| self.results.get(index))
+    }
+}
+
+extern "C" fn append_string(sink: *mut os::raw::c_void, data: *const os::raw::c_char, length: usize) {
+    unsafe {
+        let sink = &mut *(sink as *mut Vec<u8>);
+        sink.extend_from_slice(slice::from_raw_parts(data as *const u8, length));
+    }
+}
@@ -0,0 +1,216 @@
+//! Native classes that expose Rust values to Javascript as objects.
+//!
+//! A [`NativeClass`](struct.NativeClass.html) is a Javascript constructor function whose instances
+//! each own a Rust value.  The value is stored as an aligned pointer in an internal field of the
+//! instance, so dispatching a method to it is a single pointer load.  Methods live on the
+//! prototype and are guarded by a `Signature`, so V8 rejects calls with a foreign receiver before
+//! any Rust code runs.  When the garbage collector reclaims an instance, the Rust value is
+//! dropped.
+use v8_sys as v8;
+use context;
+use isolate;
+use template;
+use util;
+use value;
+use std::cell;
+use std::os;
+use std::rc;
+
+/// The internal field that holds the pointer to the Rust value of an instance.
+const VALUE_FIELD: u32 = 0;
+
+/// A callback that constructs the Rust value of a new instance.
+pub type ConstructorCallback<T> = Fn(value::FunctionCallbackInfo) -> Result<T, value::Value> +
+                                  'static;
+
+/// A callback that implements a method on the Rust value of an instance.
+pub type MethodCallback<T> = Fn(&T, value::FunctionCallbackInfo)
+                                -> Result<value::Value, value::Value> + 'static;
+
+/// A callback that returns the number of bytes that a Rust value owns outside of the V8 heap.
+pub type ExternalSizeCallback<T> = Fn(&T) -> usize + 'static;
+
+/// A Javascript class backed by Rust values of type `T`.
+pub struct NativeClass<T> {
+    isolate: isolate::Isolate,
+    template: template::FunctionTemplate,
+    signature: template::Signature,
+    external_size: rc::Rc<cell::RefCell<Option<Box<ExternalSizeCallback<T>>>>>,
+    instantiated: cell::Cell<bool>,
+}
+
+/// The heap cell owning the Rust value of an instance.
+///
+/// V8 requires pointers stored in internal fields to be 2-byte-aligned, which the empty array
+/// guarantees even for types with an alignment of 1.
+struct Instance<T> {
+    value: T,
+    _align: [u16; 0],
+}
+
+impl<T> NativeClass<T>
+    where T: 'static
+{
+    /// Creates a new native class with the specified name.
+    ///
+    /// When the class is called as a constructor from Javascript, the constructor callback is
+    /// invoked to create the Rust value of the new instance.  Calling the class without `new`
+    /// throws a `TypeError`.
+    pub fn new(isolate: &isolate::Isolate,
+               context: &context::Context,
+               name: &str,
+               constructor: Box<ConstructorCallback<T>>)
+               -> NativeClass<T> {
+        let class_name = value::String::internalized_from_str(isolate, name);
+        let error_message = format!("Class constructor {} cannot be invoked without 'new'", name);
+        let external_size: rc::Rc<cell::RefCell<Option<Box<ExternalSizeCallback<T>>>>> =
+            rc::Rc::new(cell::RefCell::new(None));
+        let constructor_external_size = external_size.clone();
+
+        let callback = move |info: value::FunctionCallbackInfo| {
+            if !info.is_construct_call {
+                let message = value::String::from_str(&info.isolate, &error_message);
+                return Err(value::Exception::type_error(&info.isolate, &message));
+            }
+
+            let isolate = info.isolate.clone();
+            let this = info.this.clone();
+            let value = try!(constructor(info));
+            let size = measure(&constructor_external_size, &value);
+            unsafe { attach(&isolate, &this, value, size) };
+            Ok(this.into())
+        };
+
+        let template = template::FunctionTemplate::new(isolate, context, Box::new(callback));
+        template.set_class_name(&class_name);
+        template.instance_template().set_internal_field_count(VALUE_FIELD as usize + 1);
+
+        let signature = template::Signature::new_with_receiver(isolate, &template);
+
+        NativeClass {
+            isolate: isolate.clone(),
+            template: template,
+            signature: signature,
+            external_size: external_size,
+            instantiated: cell::Cell::new(false),
+        }
+    }
+
+    /// Sets a callback that measures how much memory the Rust value of each new instance owns
+    /// outside of the V8 heap.
+    ///
+    /// The measured size is reported to V8 when the instance is created, and released when it is
+    /// garbage collected.  This lets V8 take memory held by large Rust values into account when
+    /// scheduling garbage collections.
+    pub fn set_external_size(&self, callback: Box<ExternalSizeCallback<T>>) {
+        *self.external_size.borrow_mut() = Some(callback);
+    }
+
+    /// Adds a method to the prototype of this class.
+    ///
+    /// The method can only be called with an instance of this class (or of a subclass) as the
+    /// receiver; V8 throws a `TypeError` otherwise.
+    ///
+    /// # Panics
+    ///
+    /// V8 cannot change a template once it has been instantiated, so this panics if `function`
+    /// or `wrap` has already been called.
+    pub fn set_method(&self,
+                      context: &context::Context,
+                      name: &str,
+                      method: Box<MethodCallback<T>>) {
+        assert!(!self.instantiated.get(),
+                "cannot add method {:?} to a native class that has already been instantiated",
+                name);
+
+        let callback = move |info: value::FunctionCallbackInfo| {
+            let instance = unsafe {
+                info.holder.get_aligned_pointer_from_internal_field::<Instance<T>>(VALUE_FIELD)
+            };
+
+            match unsafe { instance.as_ref() } {
+                Some(instance) => method(&instance.value, info),
+                None => {
+                    let message = value::String::from_str(&info.isolate, "Illegal invocation");
+                    Err(value::Exception::type_error(&info.isolate, &message))
+                }
+            }
+        };
+
+        let method = template::FunctionTemplate::new_with_signature(&self.isolate,
+                                                                    context,
+                                                                    Box::new(callback),
+                                                                    &self.signature);
+        self.template.prototype_template().set(name, &method);
+    }
+
+    /// Returns the constructor function of this class in the specified context.
+    ///
+    /// No more methods may be added to the class after this has been called.
+    pub fn function(&self, context: &context::Context) -> value::Function {
+        self.instantiated.set(true);
+        self.template.clone().get_function(context)
+    }
+
+    /// Creates a new instance of this class that owns the specified value, without calling the
+    /// constructor callback.
+    ///
+    /// No more methods may be added to the class after this has been called.
+    pub fn wrap(&self, context: &context::Context, value: T) -> value::Object {
+        self.instantiated.set(true);
+        let object = self.template.instance_template().new_instance(context);
+        let size = measure(&self.external_size, &value);
+        unsafe { attach(&self.isolate, &object, value, size) };
+        object
+    }
+
+    /// Returns the Rust value owned by the specified object, if it is an instance of this class.
+    ///
+    /// The value stays alive for as long as the object handle does.
+    pub fn get<'a>(&self, object: &'a value::Object) -> Option<&'a T> {
+        let is_instance = unsafe {
+            util::invoke(&self.isolate, |c| {
+                    v8::v8_FunctionTemplate_HasInstance(c,
+                                                        self.template.as_raw(),
+                                                        object.as_raw() as v8::ValueRef)
+                })
+                .unwrap()
+        };
+
+        if !is_instance {
+            return None;
+        }
+
+        unsafe {
+            object.get_aligned_pointer_from_internal_field::<Instance<T>>(VALUE_FIELD)
+                .as_ref()
+                .map(|instance| &instance.value)
+        }
+    }
+}
+
+fn measure<T>(external_size: &cell::RefCell<Option<Box<ExternalSizeCallback<T>>>>,
+              value: &T)
+              -> usize {
+    external_size.borrow().as_ref().map(|callback| callback(value)).unwrap_or(0)
+}
+
+/// Moves the value to the heap, stores it in the object and arranges for it to be dropped when
+/// the object is garbage collected.
+unsafe fn attach<T>(isolate: &isolate::Isolate, object: &value::Object, value: T, size: usize) {
+    let instance = Box::into_raw(Box::new(Instance {
+        value: value,
+        _align: [],
+    }));
+
+    object.set_aligned_pointer_in_internal_field(VALUE_FIELD, instance);
+
+    util::invoke(isolate, |c| {
+            v8::v8_Value_SetWeakFinalizer(c,
+                                          object.as_raw() as v8::ValueRef,
+                                          Some(util::drop_in_finalizer::<Instance<T>>),
+                                          instance as *mut os::raw::c_void,
+                                          size as i64)
+        })
+        .unwrap();
+}
@@ -0,0 +1,101 @@
+//! The clock that V8 measures time with, and how its background tasks are run.
+//!
+//! By default, V8 reads the monotonic clock of the host, and background tasks such as concurrent
+//! sweeping run on OS threads as soon as they are posted.  Garbage collection heuristics and
+//! delayed foreground tasks therefore behave a little differently on every run, which shows up as
+//! noise in benchmarks.
+//!
+//! With [`use_virtual_time`](fn.use_virtual_time.html), time only passes when the embedder calls
+//! [`advance`](fn.advance.html), and background tasks either run on the thread that posts them,
+//! or are queued and run in the order they were posted by
+//! [`run_background_tasks`](fn.run_background_tasks.html).  V8 also gets the `--predictable`
+//! flag, which turns off its own concurrent and parallel phases.
+//!
+//! Virtual time only affects the clock of the platform: `Date.now()` still reads the system time.
+use error;
+use initialization;
+use isolate;
+use platform;
+use std::time;
+
+/// How background tasks are run in virtual time.
+#[derive(Clone, Copy, Debug, Eq, Hash, PartialEq)]
+pub enum BackgroundTasks {
+    /// Tasks run on the thread that posts them, before V8 continues.
+    Inline,
+    /// Tasks are queued, and run in the order they were posted by `run_background_tasks`.
+    ///
+    /// V8 may wait for a background task it has posted, so the embedder should run the queue
+    /// whenever it runs the foreground tasks of its isolates.
+    Queued,
+}
+
+/// Switches V8 to a virtual clock that starts at zero, with background tasks run as specified.
+///
+/// Fails if V8 has already been initialized, since time would then jump backwards.
+pub fn use_virtual_time(background_tasks: BackgroundTasks) -> error::Result<()> {
+    let error = "virtual time must be enabled before the first isolate is created";
+
+    if isolate::is_initialized() {
+        return Err(error.into());
+    }
+
+    // An isolate created concurrently must either see both the flag and the virtual clock, or
+    // neither of them
+    initialization::exclusive(|passed| {
+        if isolate::is_initialized() {
+            return Err(error.into());
+        }
+
+        initialization::pass_flag(passed, "--predictable");
+        platform::enable_virtual_time(background_tasks);
+        Ok(())
+    })
+}
+
+/// Whether V8 runs on virtual time.
+pub fn is_virtual() -> bool {
+    platform::is_virtual_time()
+}
+
+/// The current time of the platform, relative to an arbitrary but fixed starting point.
+pub fn now() -> time::Duration {
+    platform::now()
+}
+
+/// Advances virtual time by the specified duration.  Delayed foreground tasks that become due are
+/// run by the next call to `isolate.run_enqueued_tasks()`.
+///
+/// Fails if V8 runs on the clock of the host.
+pub fn advance(duration: time::Duration) -> error::Result<()> {
+    if platform::advance_virtual_time(duration) {
+        Ok(())
+    } else {
+        Err("time can only be advanced after use_virtual_time".into())
+    }
+}
+
+/// Runs queued background tasks until the queue is empty, including tasks that are posted while
+/// doing so, and returns how many were run.
+pub fn run_background_tasks() -> usize {
+    let mut count = 0;
+
+    while platform::run_queued_background_task() {
+        count += 1;
+    }
+
+    count
+}
+
+/// Runs the specified closure as a background task, in the same way as the background tasks of V8.
+///
+/// In virtual time, it runs inline or is queued according to the mode passed to
+/// `use_virtual_time`, in order with the tasks of V8; otherwise it runs on a background thread.
+pub fn post_background_task(task: Box<FnMut() + Send + 'static>) {
+    platform::post_background_task(platform::Task::new(task));
+}
+
+/// The number of background tasks that are queued.
+pub fn pending_background_tasks() -> usize {
+    platform::queued_background_tasks()
+}
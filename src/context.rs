@@ -1,8 +1,26 @@
 //! Execution contexts and sandboxing.
+//!
+//! # Slots
+//!
+//! A context can carry native state for the code running in it, such as the id of the request
+//! that it serves.  Such state is stored in typed slots with `Context::set_slot`, at most one
+//! value per type.  The slots live in the embedder data of the context, so a callback can look up
+//! the state of the context that it is running in with `Context::current_slot`, which takes a
+//! single call into V8.  The values in the slots are dropped when the context is garbage
+//! collected.
 use v8_sys as v8;
 use isolate;
+use template;
 use util;
 use value;
+use std::any;
+use std::collections;
+use std::os;
+use std::ptr;
+use std::rc;
+
+/// The embedder data index that holds the slots of a context.  Index 0 is left for the debugger.
+const SLOTS_INDEX: os::raw::c_int = 1;
 
 /// A sandboxed execution context with its own set of built-in objects and functions.
 #[derive(Debug)]
@@ -10,23 +28,146 @@ pub struct Context(isolate::Isolate, v8::ContextRef);
 
 /// A guard that keeps a context bound while it is in scope.
 #[must_use]
-pub struct ContextGuard<'a>(&'a Context);
+pub struct ContextGuard<'a>(&'a Context, usize);
+
+/// A guard that keeps the isolate and a context entered while it is in scope.
+///
+/// Calls into V8 normally enter the isolate, and the context they run in, on every call.  While
+/// this guard is alive, calls that pass the same `Context` handle that the guard was created from
+/// skip that work, which adds up for code that makes many small calls such as property accesses.
+/// Calls with other contexts still enter them as usual.
+///
+/// Guards may be nested, but must be dropped in the reverse order of their creation; dropping one
+/// while a guard created after it is still alive panics.
+#[must_use]
+pub struct EnteredContext<'a> {
+    context: &'a Context,
+    depth: usize,
+}
+
+/// The values stored in the slots of a context, keyed by type.
+struct Slots(collections::HashMap<any::TypeId, Box<any::Any>>);
 
 impl Context {
     /// Creates a new context and returns a handle to the newly allocated context.
     pub fn new(isolate: &isolate::Isolate) -> Context {
+        let raw = unsafe { util::invoke(isolate, |c| v8::v8_Context_New(c)).unwrap() };
+        Context::from_new_raw(isolate, raw)
+    }
+
+    /// Creates a new context whose global object is an instance of the specified template.
+    ///
+    /// Properties configured on the template, such as lazy data properties, are set up once and
+    /// instantiated by V8 for every context, which is much cheaper than installing them on the
+    /// global object of each context.
+    pub fn new_with_global_template(isolate: &isolate::Isolate,
+                                    global_template: &template::ObjectTemplate)
+                                    -> Context {
+        let raw = unsafe {
+            util::invoke(isolate, |c| {
+                    v8::v8_Context_New_GlobalTemplate(c, global_template.as_raw())
+                })
+                .unwrap()
+        };
+        Context::from_new_raw(isolate, raw)
+    }
+
+    fn from_new_raw(isolate: &isolate::Isolate, raw: v8::ContextRef) -> Context {
+        let context = Context(isolate.clone(), raw);
+
+        // Reading embedder data that was never set is a fatal error, so the slots must always
+        // be present, even when empty.
+        unsafe { context.set_slots(::std::ptr::null_mut()) };
+        context
+    }
+
+    /// Stores a value in the slot for its type, replacing any previous value of the same type.
+    pub fn set_slot<A>(&self, value: A)
+        where A: 'static
+    {
+        unsafe {
+            let mut slots = self.get_slots();
+
+            if slots.is_null() {
+                slots = Box::into_raw(Box::new(Slots(collections::HashMap::new())));
+                self.set_slots(slots);
+                util::invoke(&self.0, |c| {
+                        v8::v8_Context_SetWeakFinalizer(c,
+                                                        self.1,
+                                                        Some(util::drop_in_finalizer::<Slots>),
+                                                        slots as *mut os::raw::c_void)
+                    })
+                    .unwrap();
+            }
+
+            (*slots).0.insert(any::TypeId::of::<A>(), Box::new(rc::Rc::new(value)));
+        }
+    }
+
+    /// Returns the value in the slot for the specified type, if there is one.
+    pub fn slot<A>(&self) -> Option<rc::Rc<A>>
+        where A: 'static
+    {
+        unsafe { lookup_slot(self.get_slots()) }
+    }
+
+    /// Returns the value in the slot for the specified type of the context that is currently
+    /// bound to the isolate, if there is one.
+    ///
+    /// This is meant to be used from callbacks, where it is the cheapest way to get at state
+    /// associated with the calling context.
+    pub fn current_slot<A>(isolate: &isolate::Isolate) -> Option<rc::Rc<A>>
+        where A: 'static
+    {
         unsafe {
-            Context(isolate.clone(),
-                    util::invoke(isolate, |c| v8::v8_Context_New(c)).unwrap())
+            let slots =
+                v8::v8_Isolate_GetCurrentContextAlignedPointer(isolate.as_raw(), SLOTS_INDEX);
+            lookup_slot(slots as *mut Slots)
         }
     }
 
+    unsafe fn get_slots(&self) -> *mut Slots {
+        util::invoke(&self.0, |c| {
+                v8::v8_Context_GetAlignedPointerFromEmbedderData(c, self.1, SLOTS_INDEX)
+            })
+            .unwrap() as *mut Slots
+    }
+
+    unsafe fn set_slots(&self, slots: *mut Slots) {
+        util::invoke(&self.0, |c| {
+                v8::v8_Context_SetAlignedPointerInEmbedderData(c,
+                                                               self.1,
+                                                               SLOTS_INDEX,
+                                                               slots as *mut os::raw::c_void)
+            })
+            .unwrap()
+    }
+
     /// Binds the context to the current scope.
     ///
-    /// Within this scope, functionality that relies on implicit contexts will work.
+    /// Within this scope, functionality that relies on implicit contexts will work.  Like an
+    /// `EnteredContext`, the guard must be dropped before any guard that was created before it.
     pub fn make_current(&self) -> ContextGuard {
         self.enter();
-        ContextGuard(self)
+        // A null entry keeps calls within this scope from skipping the entry of the context
+        // entered by an enclosing `EnteredContext`, which is no longer the current one.
+        let depth = self.0.push_entered_context_raw(ptr::null_mut());
+        ContextGuard(self, depth)
+    }
+
+    /// Enters the isolate and this context until the returned guard is dropped.
+    ///
+    /// Use this around a batch of operations in this context; see
+    /// [`EnteredContext`](struct.EnteredContext.html).
+    pub fn enter_sticky(&self) -> EnteredContext {
+        unsafe { v8::v8_Isolate_Enter(self.0.as_raw()) };
+        self.enter();
+        let depth = self.0.push_entered_context_raw(self.1);
+
+        EnteredContext {
+            context: self,
+            depth: depth,
+        }
     }
 
     fn enter(&self) {
@@ -67,8 +208,27 @@ impl Context {
 
 reference!(Context, v8::v8_Context_CloneRef, v8::v8_Context_DestroyRef);
 
+unsafe fn lookup_slot<A>(slots: *mut Slots) -> Option<rc::Rc<A>>
+    where A: 'static
+{
+    slots.as_ref()
+        .and_then(|slots| slots.0.get(&any::TypeId::of::<A>()))
+        .and_then(|value| value.downcast_ref::<rc::Rc<A>>())
+        .cloned()
+}
+
 impl<'a> Drop for ContextGuard<'a> {
     fn drop(&mut self) {
-        self.0.exit()
+        let context = self.0;
+        context.0.pop_entered_context_raw(self.1);
+        context.exit()
+    }
+}
+
+impl<'a> Drop for EnteredContext<'a> {
+    fn drop(&mut self) {
+        self.context.0.pop_entered_context_raw(self.depth);
+        self.context.exit();
+        unsafe { v8::v8_Isolate_Exit(self.context.0.as_raw()) };
     }
 }
@@ -9,13 +9,32 @@ use value;
 
 error_chain! {
     errors {
-        Javascript(message: String, stack_trace: CapturedStackTrace) {
+        Javascript(exception: JavascriptException) {
             description("Javascript exception")
-            display("Javascript exception: {}\n{}", message, stack_trace)
+            display("Javascript exception: {}\n{}", exception.message(), exception.stack_trace())
         }
     }
 }
 
+/// A Javascript exception that was thrown and not caught by any script.
+///
+/// The exception only holds on to the raw exception value and message handles; the message string
+/// and stack trace are rendered when they are asked for.  This keeps exceptions cheap for code that
+/// throws a lot but rarely looks at the details.  Use `to_captured` for a copy that is separated
+/// from the isolate, for example to send it to another thread.
+#[derive(Clone, Debug)]
+pub struct JavascriptException {
+    exception: value::Value,
+    message: Message,
+}
+
+/// A rendered Javascript exception, that is separated from its underlying isolate.
+#[derive(Clone, Debug)]
+pub struct CapturedException {
+    pub message: String,
+    pub stack_trace: CapturedStackTrace,
+}
+
 /// A captured stack trace, that is separated from its underlying isolate.
 #[derive(Clone, Debug)]
 pub struct CapturedStackTrace {
@@ -45,6 +64,50 @@ pub struct StackTrace(isolate::Isolate, v8::StackTraceRef);
 #[derive(Debug)]
 pub struct StackFrame(isolate::Isolate, v8::StackFrameRef);
 
+impl JavascriptException {
+    /// Creates an exception from the thrown value and its message.
+    pub fn new(exception: value::Value, message: Message) -> JavascriptException {
+        JavascriptException {
+            exception: exception,
+            message: message,
+        }
+    }
+
+    /// The value that was thrown.
+    pub fn exception(&self) -> &value::Value {
+        &self.exception
+    }
+
+    /// The message handle describing the exception.
+    pub fn message_handle(&self) -> &Message {
+        &self.message
+    }
+
+    /// Renders the error message string.
+    pub fn message(&self) -> String {
+        let isolate = &self.message.0;
+        let context = isolate.current_context()
+            .or_else(|| self.exception.clone().into_object().map(|o| o.creation_context()))
+            .unwrap_or_else(|| context::Context::new(isolate));
+
+        self.message.get(&context).value()
+    }
+
+    /// Captures the stack trace to the point where the exception was thrown.
+    pub fn stack_trace(&self) -> CapturedStackTrace {
+        self.message.get_stack_trace().to_captured()
+    }
+
+    /// Renders the message and stack trace into a copy that doesn't retain a reference to the
+    /// isolate.
+    pub fn to_captured(&self) -> CapturedException {
+        CapturedException {
+            message: self.message(),
+            stack_trace: self.stack_trace(),
+        }
+    }
+}
+
 impl Message {
     // TODO: pub fn get_script_origin(&self)
 
@@ -165,6 +228,12 @@ impl StackFrame {
     }
 }
 
+impl fmt::Display for CapturedException {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "Javascript exception: {}\n{}", self.message, self.stack_trace)
+    }
+}
+
 impl fmt::Display for CapturedStackTrace {
     fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
         for frame in self.frames.iter() {
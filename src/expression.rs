@@ -0,0 +1,210 @@
+//! Caching compiled expressions.
+//!
+//! Rule and template engines tend to evaluate the same small expressions, such as `a.b > 3 && c`,
+//! over and over again.  An [`ExpressionCache`](struct.ExpressionCache.html) compiles each distinct
+//! expression once into a function taking a fixed set of parameters, so evaluating a cached
+//! expression is a single function call.  Least recently used expressions are evicted once the
+//! cache grows beyond its limits.
+use v8_sys as v8;
+use context;
+use error;
+use isolate;
+use util;
+use value;
+use std::collections;
+use std::os;
+
+/// A cache of expressions compiled into functions.
+///
+/// All expressions in a cache are compiled in the same context, and take the same parameters.
+#[derive(Debug)]
+pub struct ExpressionCache {
+    isolate: isolate::Isolate,
+    context: context::Context,
+    parameters: Vec<value::String>,
+    max_entries: Option<usize>,
+    max_bytes: Option<usize>,
+    entries: collections::HashMap<String, Entry>,
+    recency: collections::BTreeMap<u64, String>,
+    tick: u64,
+    bytes: usize,
+    stats: Stats,
+}
+
+/// Counters describing how well a cache is doing.
+#[derive(Clone, Copy, Debug, Default, Eq, PartialEq)]
+pub struct Stats {
+    /// The number of lookups that found a compiled expression.
+    pub hits: u64,
+    /// The number of lookups that had to compile the expression.
+    pub misses: u64,
+    /// The number of expressions that were evicted to stay within the limits.
+    pub evictions: u64,
+}
+
+#[derive(Debug)]
+struct Entry {
+    function: value::Function,
+    tick: u64,
+}
+
+impl ExpressionCache {
+    /// Creates a new unbounded cache for expressions over the specified parameter names.
+    pub fn new(isolate: &isolate::Isolate,
+               context: &context::Context,
+               parameters: &[&str])
+               -> ExpressionCache {
+        ExpressionCache {
+            isolate: isolate.clone(),
+            context: context.clone(),
+            parameters: parameters.iter()
+                .map(|p| value::String::internalized_from_str(isolate, p))
+                .collect(),
+            max_entries: None,
+            max_bytes: None,
+            entries: collections::HashMap::new(),
+            recency: collections::BTreeMap::new(),
+            tick: 0,
+            bytes: 0,
+            stats: Stats::default(),
+        }
+    }
+
+    /// Limits the number of expressions kept in the cache.
+    pub fn set_max_entries(&mut self, max_entries: usize) {
+        self.max_entries = Some(max_entries);
+        self.evict();
+    }
+
+    /// Limits the total source length, in bytes, of the expressions kept in the cache.
+    ///
+    /// V8 does not expose the size of compiled code, so the source length stands in for it.
+    pub fn set_max_bytes(&mut self, max_bytes: usize) {
+        self.max_bytes = Some(max_bytes);
+        self.evict();
+    }
+
+    /// Returns the function that evaluates the specified expression, compiling it if it is not in
+    /// the cache.
+    ///
+    /// Fails if the expression does not compile.
+    pub fn get(&mut self, expression: &str) -> error::Result<value::Function> {
+        self.tick += 1;
+        let tick = self.tick;
+
+        if let Some(entry) = self.entries.get_mut(expression) {
+            self.stats.hits += 1;
+            let key = self.recency.remove(&entry.tick).unwrap();
+            self.recency.insert(tick, key);
+            entry.tick = tick;
+            return Ok(entry.function.clone());
+        }
+
+        self.stats.misses += 1;
+
+        let function = try!(self.compile(expression));
+        self.entries.insert(expression.to_owned(),
+                            Entry {
+                                function: function.clone(),
+                                tick: tick,
+                            });
+        self.recency.insert(tick, expression.to_owned());
+        self.bytes += expression.len();
+        self.evict();
+
+        Ok(function)
+    }
+
+    /// Evaluates the specified expression with the specified arguments, one for each parameter of
+    /// the cache.
+    pub fn evaluate(&mut self,
+                    expression: &str,
+                    args: &[&value::ToValue])
+                    -> error::Result<value::Value> {
+        let function = try!(self.get(expression));
+        let args = args.iter()
+            .map(|arg| arg.to_value(&self.isolate, &self.context).into_value(&self.isolate))
+            .collect::<Vec<_>>();
+        let arg_refs = args.iter().collect::<Vec<_>>();
+        let receiver = value::undefined(&self.isolate);
+
+        function.call_with_this(&self.context, &receiver, &arg_refs)
+    }
+
+    /// The number of expressions in the cache.
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    /// Whether the cache has no expressions.
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// The total source length, in bytes, of the expressions in the cache.
+    pub fn bytes(&self) -> usize {
+        self.bytes
+    }
+
+    /// Returns the hit, miss and eviction counters of the cache.
+    pub fn stats(&self) -> Stats {
+        self.stats
+    }
+
+    /// Removes all expressions from the cache.  The counters are kept.
+    pub fn clear(&mut self) {
+        self.entries.clear();
+        self.recency.clear();
+        self.bytes = 0;
+    }
+
+    fn compile(&self, expression: &str) -> error::Result<value::Function> {
+        // The newline keeps a trailing line comment in the expression from swallowing the paren.
+        let body = format!("return ({}\n);", expression);
+        let source = value::String::from_str(&self.isolate, &body);
+        let mut parameters = self.parameters.iter().map(|p| p.as_raw()).collect::<Vec<_>>();
+
+        unsafe {
+            let raw = try!(util::invoke_ctx(&self.isolate, &self.context, |c| {
+                v8::v8_ScriptCompiler_CompileFunctionInContext(c,
+                                                               self.context.as_raw(),
+                                                               source.as_raw(),
+                                                               parameters.len() as
+                                                               os::raw::c_int,
+                                                               parameters.as_mut_ptr())
+            }));
+            Ok(value::Function::from_raw(&self.isolate, raw))
+        }
+    }
+
+    fn evict(&mut self) {
+        while self.over_limits() {
+            let oldest = match self.recency.keys().next() {
+                Some(&tick) => tick,
+                None => return,
+            };
+            let key = self.recency.remove(&oldest).unwrap();
+            self.entries.remove(&key);
+            self.bytes -= key.len();
+            self.stats.evictions += 1;
+        }
+    }
+
+    fn over_limits(&self) -> bool {
+        self.max_entries.map_or(false, |max| self.entries.len() > max) ||
+        self.max_bytes.map_or(false, |max| self.bytes > max)
+    }
+}
+
+impl Stats {
+    /// The fraction of lookups that found a compiled expression, or 0 if there were none.
+    pub fn hit_rate(&self) -> f64 {
+        let lookups = self.hits + self.misses;
+
+        if lookups == 0 {
+            0.0
+        } else {
+            self.hits as f64 / lookups as f64
+        }
+    }
+}
@@ -0,0 +1,278 @@
+//! V8 flag configuration.
+//!
+//! Most V8 flags only take effect when V8 is initialized, which happens when the first isolate is
+//! created.  A [`Flags`](struct.Flags.html) configuration, usually started from one of the
+//! [`Preset`](enum.Preset.html)s, is validated and applied with [`configure`](fn.configure.html)
+//! before that.  The flags that have been passed to V8 can be read back with
+//! [`passed_flags`](fn.passed_flags.html) for diagnostics.
+//!
+//! Flags that are not set keep their V8 defaults.
+use error;
+use initialization;
+use isolate;
+use std::fmt;
+use std::str;
+
+/// A typed set of V8 flags.
+#[derive(Clone, Debug, Default, Eq, PartialEq)]
+pub struct Flags {
+    min_semi_space_size: Option<usize>,
+    max_semi_space_size: Option<usize>,
+    max_old_space_size: Option<usize>,
+    stack_size: Option<usize>,
+    optimize_for_size: Option<bool>,
+    lazy: Option<bool>,
+    concurrent_recompilation: Option<bool>,
+    expose_gc: Option<bool>,
+    expose_wasm: Option<bool>,
+    raw: Vec<String>,
+}
+
+/// Named flag configurations for common deployments.
+#[derive(Clone, Copy, Debug, Eq, Hash, PartialEq)]
+pub enum Preset {
+    /// Keeps the heap small: small semi-spaces, and code and data structures optimized for size.
+    LowMemory,
+    /// Favors sustained execution speed: larger semi-spaces to scavenge less often, and optimizing
+    /// compilation on a background thread.
+    Throughput,
+    /// Favors a fast start on small hosts: lazy compilation, and no background recompilation
+    /// thread competing for the few cores.
+    Startup,
+}
+
+impl Flags {
+    /// Creates an empty set of flags, that leaves all V8 defaults in place.
+    pub fn new() -> Flags {
+        Flags::default()
+    }
+
+    /// Creates the flags of the specified preset, which can be refined further.
+    pub fn preset(preset: Preset) -> Flags {
+        match preset {
+            Preset::LowMemory => {
+                Flags::new()
+                    .min_semi_space_size(1)
+                    .max_semi_space_size(1)
+                    .optimize_for_size(true)
+            }
+            Preset::Throughput => {
+                Flags::new()
+                    .min_semi_space_size(16)
+                    .max_semi_space_size(32)
+                    .concurrent_recompilation(true)
+            }
+            Preset::Startup => Flags::new().lazy(true).concurrent_recompilation(false),
+        }
+    }
+
+    /// The initial size of a semi-space of the young generation, in megabytes.
+    pub fn min_semi_space_size(mut self, megabytes: usize) -> Flags {
+        self.min_semi_space_size = Some(megabytes);
+        self
+    }
+
+    /// The maximum size of a semi-space of the young generation, in megabytes.
+    pub fn max_semi_space_size(mut self, megabytes: usize) -> Flags {
+        self.max_semi_space_size = Some(megabytes);
+        self
+    }
+
+    /// The maximum size of the old generation, in megabytes.
+    pub fn max_old_space_size(mut self, megabytes: usize) -> Flags {
+        self.max_old_space_size = Some(megabytes);
+        self
+    }
+
+    /// The stack size that V8 assumes, in kilobytes.
+    pub fn stack_size(mut self, kilobytes: usize) -> Flags {
+        self.stack_size = Some(kilobytes);
+        self
+    }
+
+    /// Whether V8 should favor a small footprint over speed.
+    pub fn optimize_for_size(mut self, value: bool) -> Flags {
+        self.optimize_for_size = Some(value);
+        self
+    }
+
+    /// Whether functions are only compiled when they are first called.
+    pub fn lazy(mut self, value: bool) -> Flags {
+        self.lazy = Some(value);
+        self
+    }
+
+    /// Whether optimizing compilation runs on a background thread.
+    pub fn concurrent_recompilation(mut self, value: bool) -> Flags {
+        self.concurrent_recompilation = Some(value);
+        self
+    }
+
+    /// Whether scripts can trigger a garbage collection with `gc()`.
+    pub fn expose_gc(mut self, value: bool) -> Flags {
+        self.expose_gc = Some(value);
+        self
+    }
+
+    /// Whether the `WebAssembly` object is installed in new contexts.
+    pub fn expose_wasm(mut self, value: bool) -> Flags {
+        self.expose_wasm = Some(value);
+        self
+    }
+
+    /// Adds a flag that has no typed setter, such as `--trace_gc` or `--stack_trace_limit=50`.
+    ///
+    /// The flag is only checked for being well-formed, since V8 does not report unknown flags.  A
+    /// flag can't contain whitespace, which V8 would take as the start of another flag.
+    pub fn raw(mut self, flag: &str) -> Flags {
+        self.raw.push(flag.to_owned());
+        self
+    }
+
+    /// Checks that the flags are consistent and well-formed.
+    pub fn validate(&self) -> error::Result<()> {
+        let sizes = [("min_semi_space_size", self.min_semi_space_size),
+                     ("max_semi_space_size", self.max_semi_space_size),
+                     ("max_old_space_size", self.max_old_space_size),
+                     ("stack_size", self.stack_size)];
+
+        for &(name, size) in sizes.iter() {
+            if size == Some(0) {
+                return Err(format!("--{} must be positive", name).into());
+            }
+        }
+
+        if let (Some(min), Some(max)) = (self.min_semi_space_size, self.max_semi_space_size) {
+            if min > max {
+                return Err(format!("--min_semi_space_size ({}) exceeds --max_semi_space_size \
+                                    ({})",
+                                   min,
+                                   max)
+                    .into());
+            }
+        }
+
+        for flag in &self.raw {
+            if !is_well_formed(flag) {
+                return Err(format!("malformed V8 flag {:?}", flag).into());
+            }
+        }
+
+        Ok(())
+    }
+
+    /// The command line arguments that these flags correspond to.
+    pub fn to_args(&self) -> Vec<String> {
+        let mut args = Vec::new();
+
+        let sizes = [("min_semi_space_size", self.min_semi_space_size),
+                     ("max_semi_space_size", self.max_semi_space_size),
+                     ("max_old_space_size", self.max_old_space_size),
+                     ("stack_size", self.stack_size)];
+
+        for &(name, size) in sizes.iter() {
+            if let Some(size) = size {
+                args.push(format!("--{}={}", name, size));
+            }
+        }
+
+        let switches = [("optimize_for_size", self.optimize_for_size),
+                        ("lazy", self.lazy),
+                        ("concurrent_recompilation", self.concurrent_recompilation),
+                        ("expose_gc", self.expose_gc),
+                        ("expose_wasm", self.expose_wasm)];
+
+        for &(name, value) in switches.iter() {
+            match value {
+                Some(true) => args.push(format!("--{}", name)),
+                Some(false) => args.push(format!("--no{}", name)),
+                None => (),
+            }
+        }
+
+        args.extend(self.raw.iter().cloned());
+        args
+    }
+}
+
+impl Preset {
+    /// The name of the preset, as accepted by `from_str`.
+    pub fn name(&self) -> &'static str {
+        match *self {
+            Preset::LowMemory => "low-memory",
+            Preset::Throughput => "throughput",
+            Preset::Startup => "startup",
+        }
+    }
+}
+
+impl str::FromStr for Preset {
+    type Err = error::Error;
+
+    fn from_str(name: &str) -> error::Result<Preset> {
+        match name {
+            "low-memory" => Ok(Preset::LowMemory),
+            "throughput" => Ok(Preset::Throughput),
+            "startup" => Ok(Preset::Startup),
+            _ => Err(format!("unknown flag preset {:?}", name).into()),
+        }
+    }
+}
+
+impl fmt::Display for Preset {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        f.write_str(self.name())
+    }
+}
+
+/// Validates the specified flags and passes them to V8.
+///
+/// Fails if the flags are invalid, or if V8 has already been initialized, since most flags would
+/// then silently have no effect.
+pub fn configure(flags: &Flags) -> error::Result<()> {
+    try!(flags.validate());
+
+    initialization::exclusive(|passed| {
+        if isolate::is_initialized() {
+            return Err("V8 flags must be configured before the first isolate is created".into());
+        }
+
+        for arg in flags.to_args() {
+            initialization::pass_flag(passed, &arg);
+        }
+
+        Ok(())
+    })
+}
+
+/// Passes a single flag to V8, also after initialization.
+///
+/// Only a few flags, such as `--expose_wasm`, still have an effect once V8 has been initialized;
+/// use `configure` for everything else.
+pub fn set_from_string(flag: &str) {
+    initialization::exclusive(|passed| initialization::pass_flag(passed, flag));
+}
+
+/// Returns every flag that has been passed to V8 so far, in the order they were passed.
+///
+/// This includes flags passed by `configure`, by `set_from_string` and internally (for example by
+/// `clock::use_virtual_time`), even those that came after initialization and thus may not have
+/// taken effect.  It does not include flags that V8 was never given, such as the flags of a
+/// `configure` call that failed.
+pub fn passed_flags() -> Vec<String> {
+    initialization::exclusive(|passed| passed.clone())
+}
+
+fn is_well_formed(flag: &str) -> bool {
+    if !flag.starts_with("--") || flag.chars().any(|c| c.is_whitespace()) {
+        return false;
+    }
+
+    let name = flag[2..].split('=').next().unwrap();
+
+    !name.is_empty() &&
+    name.chars().all(|c| match c {
+        'a'...'z' | 'A'...'Z' | '0'...'9' | '_' | '-' => true,
+        _ => false,
+    })
+}
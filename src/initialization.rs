@@ -0,0 +1,30 @@
+//! Coordination of V8 flags with the initialization of V8.
+//!
+//! Most flags only take effect if they are passed before V8 is initialized, so flags are passed to
+//! V8, and V8 is marked as initialized, while holding a single lock.  That way a flag is either
+//! passed before initialization starts, or its caller learns that it came too late.
+use v8_sys as v8;
+use std::os;
+use std::sync;
+
+lazy_static! {
+    static ref PASSED_FLAGS: sync::Mutex<Vec<String>> = sync::Mutex::new(Vec::new());
+}
+
+/// Runs the specified function while holding the lock, with the flags that have been passed to V8
+/// so far.
+pub fn exclusive<F, R>(f: F) -> R
+    where F: FnOnce(&mut Vec<String>) -> R
+{
+    let mut passed = PASSED_FLAGS.lock().unwrap();
+    f(&mut passed)
+}
+
+/// Passes a single flag to V8, and records it among the passed flags.
+pub fn pass_flag(passed: &mut Vec<String>, flag: &str) {
+    unsafe {
+        v8::v8_V8_SetFlagsFromString(flag.as_ptr() as *const os::raw::c_char,
+                                     flag.len() as os::raw::c_int);
+    }
+    passed.push(flag.to_owned());
+}
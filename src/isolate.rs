@@ -12,31 +12,54 @@
 //! The user should therefore call `isolate.run_enqueued_tasks()` regularly to allow these tasks to
 //! run.
 //!
+//! # Finalizers
+//!
+//! Finalizers attached to weak handles are never run while the garbage collector is active.
+//! Instead, they are queued up when their value is collected, and run in a batch by
+//! `isolate.run_finalizers()`, which `isolate.run_enqueued_tasks()` also calls.
+//!
 //! # Background tasks
 //!
 //! Javascript and V8 can trigger various background tasks to run.  These will be run as simple
 //! background OS threads, while trying to keep the number of running background tasks less than the
 //! number of available CPUs.
 //!
+//! With `clock::use_virtual_time`, delayed tasks only become due as the embedder advances the
+//! clock, and background tasks run in a deterministic order instead.
+//!
 //! # Idle tasks
 //!
 //! V8 can perform various maintenance tasks if the application has nothing better to do.  If the
 //! user wants to allow this to happen, an isolate should be constructed with
 //! `Isolate::builder().supports_idle_tasks(true).build()`.  The user should then regularly call
 //! `isolate.run_idle_tasks(deadline)` to run any pending idle tasks.
+//!
+//! # Flags
+//!
+//! V8 is initialized when the first isolate is created.  To initialize it with other than the
+//! default flags, call `flags::configure` before that.
 
+use std::any;
 use std::cmp;
 use std::collections;
+use std::fmt;
 use std::mem;
 use std::os;
+use std::ptr;
 use std::sync;
+use std::thread;
 use std::time;
 use v8_sys as v8;
 use allocator;
 use context;
+use initialization;
 use platform;
+use template;
+use util;
+use value;
 
 static INITIALIZE: sync::Once = sync::ONCE_INIT;
+static INITIALIZED: sync::atomic::AtomicBool = sync::atomic::ATOMIC_BOOL_INIT;
 
 /// Isolate represents an isolated instance of the V8 engine.
 ///
@@ -44,8 +67,12 @@ static INITIALIZE: sync::Once = sync::ONCE_INIT;
 /// isolates.  The embedder can create multiple isolates and use them in parallel in multiple
 /// threads.  An isolate can be entered by at most one thread at any given time.  The
 /// Locker/Unlocker API must be used to synchronize.
+///
+/// Every value handle holds on to its isolate, so cloning and dropping an isolate handle must be
+/// cheap: the handle caches the pointer to the embedder data of the isolate, and only touches the
+/// reference count stored there, without calling into V8.
 #[derive(Debug)]
-pub struct Isolate(v8::IsolatePtr);
+pub struct Isolate(v8::IsolatePtr, *mut Data);
 
 /// A builder for isolates.  Can be converted into an isolate with the `build` method.
 pub struct Builder {
@@ -57,11 +84,22 @@ struct Data {
     count: usize,
     _allocator: allocator::Allocator,
     task_queue: collections::BinaryHeap<ScheduledTask>,
+    task_sequence: u64,
     idle_task_queue: Option<collections::VecDeque<platform::IdleTask>>,
+    panic_info_key: v8::PrivateRef,
+    finalizer_queue: Vec<Finalizer>,
+    templates: collections::HashMap<any::TypeId, v8::EternalTemplatePtr>,
+    entered_contexts: Vec<v8::ContextRef>,
+    glue_calls: usize,
 }
 
+/// A foreground task, the platform time at which it becomes due, and a sequence number that runs
+/// tasks that become due at the same time in the order they were enqueued.
 #[derive(Debug, Eq, PartialEq)]
-struct ScheduledTask(time::Instant, platform::Task);
+struct ScheduledTask(time::Duration, u64, platform::Task);
+
+/// A callback that runs once some value has been garbage collected.
+pub struct Finalizer(Box<FnMut() + 'static>);
 
 const DATA_PTR_SLOT: u32 = 0;
 
@@ -81,7 +119,8 @@ impl Isolate {
     /// This isolate must at some point have been created by `Isolate::new`, since this library
     /// expects isolates to be configured a certain way and contain embedder information.
     pub unsafe fn from_raw(raw: v8::IsolatePtr) -> Isolate {
-        let result = Isolate(raw);
+        let data = v8::v8_Isolate_GetData(raw, DATA_PTR_SLOT) as *mut Data;
+        let result = Isolate(raw, data);
         result.get_data().count += 1;
         result
     }
@@ -103,18 +142,21 @@ impl Isolate {
     }
 
     /// Runs all enqueued tasks until there are no more tasks available.
+    ///
+    /// Any pending finalizers are run as well.
     pub fn run_enqueued_tasks(&self) {
         while self.run_enqueued_task() {}
+        self.run_finalizers();
     }
 
     /// Runs a single enqueued task, if there is one.  Returns `true` if a task was executed, and
     /// `false` if there are no pending tasks to run.
     pub fn run_enqueued_task(&self) -> bool {
         let data = unsafe { self.get_data() };
-        let now = time::Instant::now();
+        let now = platform::now();
 
-        if data.task_queue.peek().map(|t| t.0 > now).unwrap_or(false) {
-            let task = data.task_queue.pop().unwrap().1;
+        if data.task_queue.peek().map(|t| t.0 <= now).unwrap_or(false) {
+            let task = data.task_queue.pop().unwrap().2;
             task.run();
             true
         } else {
@@ -157,14 +199,21 @@ impl Isolate {
 
     /// Enqueues the specified task to run as soon as possible.
     pub fn enqueue_task(&self, task: platform::Task) {
-        let scheduled_task = ScheduledTask(time::Instant::now(), task);
-        unsafe { self.get_data() }.task_queue.push(scheduled_task);
+        self.schedule_task(platform::now(), task);
     }
 
     /// Enqueues the specified task to run after the specified delay has passed.
     pub fn enqueue_delayed_task(&self, delay: time::Duration, task: platform::Task) {
-        let scheduled_task = ScheduledTask(time::Instant::now() + delay, task);
-        unsafe { self.get_data() }.task_queue.push(scheduled_task);
+        self.schedule_task(platform::now() + delay, task);
+    }
+
+    /// Schedules the specified closure to run as a foreground task of this isolate, once the
+    /// specified delay has passed on the clock of the platform.
+    ///
+    /// Like the tasks that V8 posts, it is run by `run_enqueued_tasks`, so under virtual time it
+    /// only becomes due as the clock is advanced.
+    pub fn post_task(&self, delay: time::Duration, task: Box<FnMut() + Send + 'static>) {
+        self.enqueue_delayed_task(delay, platform::Task::new(task));
     }
 
     /// Enqueues a task to be run when the isolate is considered to be "idle."
@@ -172,13 +221,181 @@ impl Isolate {
         unsafe { self.get_data() }.idle_task_queue.as_mut().unwrap().push_back(idle_task);
     }
 
+    /// Adjusts the amount of memory that V8 considers to be kept alive by Javascript objects,
+    /// while actually being allocated outside of the V8 heap, and returns the new total.
+    ///
+    /// Reporting such memory makes V8 schedule garbage collections according to how much memory
+    /// is really in use, instead of only looking at the (possibly small) wrapper objects.
+    pub fn adjust_amount_of_external_allocated_memory(&self, change_in_bytes: i64) -> i64 {
+        unsafe {
+            v8::v8_Isolate_AdjustAmountOfExternalAllocatedMemory(self.as_raw(), change_in_bytes)
+        }
+    }
+
+    /// Tells V8 that the system is running low on memory, which makes it perform a full garbage
+    /// collection.
+    ///
+    /// Finalizers of values that were collected are enqueued, and run by `run_finalizers`.
+    pub fn low_memory_notification(&self) {
+        unsafe { v8::v8_Isolate_LowMemoryNotification(self.as_raw()) }
+    }
+
+    /// Enqueues a finalizer to be run by the next call to `run_finalizers`.
+    ///
+    /// This does not call into V8, so it is safe to use while the garbage collector is active.
+    pub fn enqueue_finalizer(&self, finalizer: Finalizer) {
+        unsafe { self.get_data() }.finalizer_queue.push(finalizer);
+    }
+
+    /// Runs all finalizers whose values have been garbage collected so far, and returns how many
+    /// were run.
+    ///
+    /// Finalizers that are enqueued while this is running, for example because a finalizer
+    /// triggered a garbage collection, are run as part of the same batch.
+    pub fn run_finalizers(&self) -> usize {
+        let mut count = 0;
+
+        loop {
+            let batch = mem::replace(&mut unsafe { self.get_data() }.finalizer_queue, Vec::new());
+
+            if batch.is_empty() {
+                return count;
+            }
+
+            count += batch.len();
+
+            for finalizer in batch {
+                finalizer.run();
+            }
+        }
+    }
+
     /// Whether this isolate was configured to support idle tasks.
     pub fn supports_idle_tasks(&self) -> bool {
         unsafe { self.get_data() }.idle_task_queue.is_some()
     }
 
+    /// The private symbol under which Rust panics are attached to the exceptions that carry them
+    /// through Javascript code.
+    pub fn panic_info_key(&self) -> value::Private {
+        let key = self.panic_info_key_raw();
+
+        unsafe {
+            let raw = util::invoke(self, |c| v8::v8_Private_CloneRef(c, key)).unwrap();
+            value::Private::from_raw(self, raw)
+        }
+    }
+
+    /// The raw handle of the panic info symbol, which is owned by the isolate.
+    ///
+    /// The symbol is created the first time it is needed and then cached for the lifetime of the
+    /// isolate, so that looking for a panic does not need to clone the handle.
+    pub fn panic_info_key_raw(&self) -> v8::PrivateRef {
+        unsafe {
+            let data = self.get_data();
+
+            if data.panic_info_key.is_null() {
+                let name = value::String::from_str(self, "v8-rs::panicInfo");
+                data.panic_info_key = util::invoke(self, |c| {
+                        v8::v8_Private_ForApi(c, self.as_raw(), name.as_raw())
+                    })
+                    .unwrap();
+            }
+
+            data.panic_info_key
+        }
+    }
+
+    /// Returns the template registered for the type `T`, building it the first time it is
+    /// requested.
+    ///
+    /// The template is kept alive for as long as the isolate is, and can be used in any context
+    /// of the isolate.  The context passed in is only used if the template needs to be built.
+    pub fn template<T>(&self, context: &context::Context) -> T::Template
+        where T: template::IsolateTemplate
+    {
+        let key = any::TypeId::of::<T>();
+        let cached = unsafe { self.get_data() }.templates.get(&key).cloned();
+
+        let eternal = match cached {
+            Some(eternal) => eternal,
+            None => {
+                // Building the template might register other templates, so the data must not be
+                // borrowed while doing so
+                let template = T::build(self, context);
+                let eternal = unsafe {
+                    util::invoke(self, |c| {
+                            v8::v8_EternalTemplate_New(c, template.as_template_raw())
+                        })
+                        .unwrap()
+                };
+                unsafe { self.get_data() }.templates.insert(key, eternal);
+                eternal
+            }
+        };
+
+        unsafe {
+            let raw = util::invoke(self, |c| v8::v8_EternalTemplate_Get(c, eternal)).unwrap();
+            <T::Template as template::TemplateKind>::from_template_raw(self, raw)
+        }
+    }
+
+    /// Returns the raw context entered by the innermost `EnteredContext` guard, or null if there
+    /// is none.
+    ///
+    /// Callbacks run by V8 within a call into the glue may have made another context current, so
+    /// this is always null while such a call is in progress.
+    pub fn entered_context_raw(&self) -> v8::ContextRef {
+        let data = unsafe { self.get_data() };
+        if data.glue_calls > 0 {
+            return ptr::null_mut();
+        }
+        data.entered_contexts.last().cloned().unwrap_or(ptr::null_mut())
+    }
+
+    /// Records that a call into the glue has started on this isolate.
+    pub fn begin_glue_call(&self) {
+        unsafe { self.get_data() }.glue_calls += 1;
+    }
+
+    /// Records that a call into the glue has finished on this isolate.
+    pub fn end_glue_call(&self) {
+        unsafe { self.get_data() }.glue_calls -= 1;
+    }
+
+    /// Records the raw context entered by a new `EnteredContext` guard, returning its nesting
+    /// depth.
+    pub fn push_entered_context_raw(&self, raw: v8::ContextRef) -> usize {
+        let entered = &mut unsafe { self.get_data() }.entered_contexts;
+        entered.push(raw);
+        entered.len() - 1
+    }
+
+    /// Forgets the innermost `EnteredContext` guard, which must be the one at `depth`.
+    ///
+    /// Guards restore the state of the isolate when dropped, so they have to be dropped in the
+    /// reverse order of their creation.
+    pub fn pop_entered_context_raw(&self, depth: usize) {
+        let entered = &mut unsafe { self.get_data() }.entered_contexts;
+        // Panicking again while unwinding would abort, so a guard that is dropped out of order
+        // during a panic only gets reported by the panic that is already in progress.
+        if !thread::panicking() {
+            assert_eq!(entered.len(), depth + 1,
+                       "EnteredContext guards must be dropped in the reverse order of their \
+                        creation");
+        }
+        entered.truncate(depth);
+    }
+
+    fn schedule_task(&self, due: time::Duration, task: platform::Task) {
+        let data = unsafe { self.get_data() };
+        let sequence = data.task_sequence;
+        data.task_sequence += 1;
+        data.task_queue.push(ScheduledTask(due, sequence, task));
+    }
+
     unsafe fn get_data_ptr(&self) -> *mut Data {
-        v8::v8_Isolate_GetData(self.0, DATA_PTR_SLOT) as *mut Data
+        self.1
     }
 
     unsafe fn get_data(&self) -> &mut Data {
@@ -191,7 +408,7 @@ impl Clone for Isolate {
         unsafe {
             self.get_data().count += 1;
         }
-        Isolate(self.0)
+        Isolate(self.0, self.1)
     }
 }
 
@@ -202,7 +419,17 @@ impl Drop for Isolate {
             *count -= 1;
 
             if *count == 0 {
-                drop(Box::from_raw(self.get_data_ptr()));
+                let data = Box::from_raw(self.get_data_ptr());
+
+                if !data.panic_info_key.is_null() {
+                    v8::v8_Private_DestroyRef(data.panic_info_key);
+                }
+
+                for &eternal in data.templates.values() {
+                    v8::v8_EternalTemplate_Destroy(eternal);
+                }
+
+                drop(data);
                 v8::v8_Isolate_Dispose(self.0);
             }
         }
@@ -229,7 +456,8 @@ impl Builder {
         }
 
         unsafe {
-            assert!(v8::v8_Isolate_GetNumberOfDataSlots(raw) > 0);
+            // Slot 0 holds the data of the isolate, slot 1 the state of the glue
+            assert!(v8::v8_Isolate_GetNumberOfDataSlots(raw) > 1);
         }
 
         let idle_task_queue = if self.supports_idle_tasks {
@@ -242,7 +470,13 @@ impl Builder {
             count: 1,
             _allocator: allocator,
             task_queue: collections::BinaryHeap::new(),
+            task_sequence: 0,
             idle_task_queue: idle_task_queue,
+            panic_info_key: ptr::null_mut(),
+            finalizer_queue: Vec::new(),
+            templates: collections::HashMap::new(),
+            entered_contexts: Vec::new(),
+            glue_calls: 0,
         };
         let data_ptr: *mut Data = Box::into_raw(Box::new(data));
 
@@ -251,7 +485,30 @@ impl Builder {
             v8::v8_Isolate_SetCaptureStackTraceForUncaughtExceptions_Detailed(raw, true, 1024);
         }
 
-        Isolate(raw)
+        Isolate(raw, data_ptr)
+    }
+}
+
+impl Finalizer {
+    /// Creates a new finalizer that runs the specified function.
+    pub fn new<F>(function: F) -> Finalizer
+        where F: FnOnce() + 'static
+    {
+        let mut function = Some(function);
+        Finalizer(Box::new(move || if let Some(function) = function.take() {
+            function()
+        }))
+    }
+
+    /// Runs this finalizer.
+    pub fn run(mut self) {
+        (self.0)()
+    }
+}
+
+impl fmt::Debug for Finalizer {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "Finalizer")
     }
 }
 
@@ -263,12 +520,20 @@ impl PartialOrd for ScheduledTask {
 
 impl Ord for ScheduledTask {
     fn cmp(&self, other: &ScheduledTask) -> cmp::Ordering {
-        self.0.cmp(&other.0).reverse()
+        // The queue is a max-heap, so the earliest task has to compare as the greatest
+        (self.0, self.1).cmp(&(other.0, other.1)).reverse()
     }
 }
 
+/// Whether V8 has been initialized, which happens when the first isolate is created.
+pub fn is_initialized() -> bool {
+    INITIALIZED.load(sync::atomic::Ordering::SeqCst)
+}
+
 fn ensure_initialized() {
     INITIALIZE.call_once(|| {
+        initialization::exclusive(|_| INITIALIZED.store(true, sync::atomic::Ordering::SeqCst));
+
         unsafe {
             v8::v8_V8_InitializeICU();
 
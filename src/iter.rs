@@ -0,0 +1,547 @@
+//! Iterators over Javascript collections.
+//!
+//! Fetching the elements of a collection one by one takes a call into V8 per element.  The
+//! iterators in this module instead fetch elements in chunks of
+//! [`CHUNK_SIZE`](constant.CHUNK_SIZE.html) per call, inside of a single handle scope, and yield
+//! them from a Rust-side buffer.
+//!
+//! Likewise, a [`JsIterator`](struct.JsIterator.html) drives a Javascript iterator (for example a
+//! generator) from Rust, pulling up to [`CHUNK_SIZE`](constant.CHUNK_SIZE.html) items per call into
+//! V8.  Primitive items come back as plain Rust values, without allocating handles.
+//!
+//! In the other direction, `to_iterable` and `to_batched_iterable` expose a Rust iterator to
+//! Javascript as an iterable object, producing items only when the script asks for them.
+use v8_sys as v8;
+use context;
+use error;
+use isolate;
+use script;
+use util;
+use value;
+use value::ToValue;
+use weak;
+use std::cell;
+use std::os;
+use std::ptr;
+use std::vec;
+
+/// The number of elements that are fetched from V8 per call.
+pub const CHUNK_SIZE: usize = 256;
+
+/// An iterator over the elements of an array.
+///
+/// Elements are read with ordinary property lookups, so holes read as `undefined` and getters are
+/// invoked.  If reading an element throws, the exception is yielded and iteration ends.
+#[derive(Debug)]
+pub struct ArrayIter(Chunks);
+
+/// An iterator over the entries of a map, as key-value pairs.
+///
+/// Entries are read through the iterator of the map.  If that throws, the exception is yielded
+/// after the entries read before it, and iteration ends.
+#[derive(Debug)]
+pub struct MapIter(Entries);
+
+/// An iterator over the values of a set.
+///
+/// Values are read through the iterator of the set.  If that throws, the exception is yielded
+/// after the values read before it, and iteration ends.
+#[derive(Debug)]
+pub struct SetIter(Entries);
+
+/// An iterator over the items of a Javascript iterator.
+///
+/// If the Javascript iterator throws, the items it produced before are yielded first, then the
+/// exception, and then iteration ends.
+#[derive(Debug)]
+pub struct JsIterator {
+    isolate: isolate::Isolate,
+    context: context::Context,
+    iterator: value::Object,
+    batch_size: usize,
+    buffer: vec::IntoIter<value::ReturnValue>,
+    error: Option<error::Error>,
+    done: bool,
+}
+
+/// The Javascript half of batched iterables.  Wraps a native function that returns the next
+/// batch of items as an array, and an empty array once the items run out.
+const BATCHED_ITERATOR_SOURCE: &'static str = "(function (pull) {
+  var batch = [];
+  var index = 0;
+  var done = false;
+  var iterator = {
+    next: function () {
+      if (index === batch.length && !done) {
+        batch = pull();
+        index = 0;
+        done = batch.length === 0;
+      }
+      if (index < batch.length) {
+        return { value: batch[index++], done: false };
+      }
+      return { value: undefined, done: true };
+    }
+  };
+  iterator[Symbol.iterator] = function () { return this; };
+  return iterator;
+})";
+
+/// The compiled `BATCHED_ITERATOR_SOURCE` of a context, kept in a context slot.  The handle is
+/// weak because a strong handle in a slot would keep the context alive forever.
+struct BatchedIteratorFactory(weak::Weak<value::Function>);
+
+#[derive(Debug)]
+struct Chunks {
+    isolate: isolate::Isolate,
+    context: context::Context,
+    array: value::Array,
+    chunk_size: usize,
+    index: u32,
+    buffer: vec::IntoIter<value::Value>,
+    error: Option<error::Error>,
+    done: bool,
+}
+
+/// Values pulled in chunks from the iterator of a map or a set, `arity` values per entry.
+#[derive(Debug)]
+struct Entries {
+    isolate: isolate::Isolate,
+    context: context::Context,
+    iterator: Option<value::Object>,
+    arity: usize,
+    buffer: vec::IntoIter<value::Value>,
+    error: Option<error::Error>,
+    done: bool,
+}
+
+impl ArrayIter {
+    /// Creates an iterator over the elements of the specified array.
+    pub fn new(isolate: &isolate::Isolate,
+               context: &context::Context,
+               array: &value::Array)
+               -> ArrayIter {
+        ArrayIter(Chunks::new(isolate, context, array.clone(), CHUNK_SIZE))
+    }
+}
+
+impl MapIter {
+    /// Creates an iterator over the entries of the specified map.
+    pub fn new(isolate: &isolate::Isolate,
+               context: &context::Context,
+               map: &value::Map)
+               -> MapIter {
+        MapIter(Entries::new(isolate, context, map, 2))
+    }
+}
+
+impl SetIter {
+    /// Creates an iterator over the values of the specified set.
+    pub fn new(isolate: &isolate::Isolate,
+               context: &context::Context,
+               set: &value::Set)
+               -> SetIter {
+        SetIter(Entries::new(isolate, context, set, 1))
+    }
+}
+
+impl Iterator for ArrayIter {
+    type Item = error::Result<value::Value>;
+
+    fn next(&mut self) -> Option<error::Result<value::Value>> {
+        self.0.next()
+    }
+}
+
+impl Iterator for MapIter {
+    type Item = error::Result<(value::Value, value::Value)>;
+
+    fn next(&mut self) -> Option<error::Result<(value::Value, value::Value)>> {
+        // Entries are fetched whole, so a key is always followed by its value
+        let key = match self.0.next() {
+            Some(Ok(key)) => key,
+            Some(Err(error)) => return Some(Err(error)),
+            None => return None,
+        };
+
+        self.0.next().map(|value| value.map(|value| (key, value)))
+    }
+}
+
+impl Iterator for SetIter {
+    type Item = error::Result<value::Value>;
+
+    fn next(&mut self) -> Option<error::Result<value::Value>> {
+        self.0.next()
+    }
+}
+
+impl JsIterator {
+    /// Creates an iterator that drives the specified Javascript iterator object, which must have a
+    /// `next` method following the iterator protocol.
+    pub fn new(isolate: &isolate::Isolate,
+               context: &context::Context,
+               iterator: &value::Object)
+               -> JsIterator {
+        JsIterator {
+            isolate: isolate.clone(),
+            context: context.clone(),
+            iterator: iterator.clone(),
+            batch_size: CHUNK_SIZE,
+            buffer: Vec::new().into_iter(),
+            error: None,
+            done: false,
+        }
+    }
+
+    /// Creates an iterator over the specified iterable, by calling its `Symbol.iterator` method.
+    ///
+    /// Fails if the method throws, or if the object is not iterable.
+    pub fn from_iterable(isolate: &isolate::Isolate,
+                         context: &context::Context,
+                         iterable: &value::Object)
+                         -> error::Result<JsIterator> {
+        let iterator = try!(iterator_of(isolate, context, iterable));
+        Ok(JsIterator::new(isolate, context, &iterator))
+    }
+
+    /// Sets the maximum number of items that are pulled from the Javascript iterator per call into
+    /// V8.
+    ///
+    /// Items are pulled eagerly, so a Javascript iterator with side effects may run ahead of the
+    /// items consumed from this iterator by up to this many items.  A batch size of 1 keeps them
+    /// in lockstep.
+    pub fn set_batch_size(&mut self, batch_size: usize) {
+        assert!(batch_size > 0, "the batch size must be positive");
+        self.batch_size = batch_size;
+    }
+
+    fn fetch(&mut self) {
+        let mut raw: Vec<v8::IteratorItem> = Vec::with_capacity(self.batch_size);
+        let mut fetched = 0;
+        let mut done = false;
+
+        unsafe {
+            // The items fetched before an exception are kept, and the exception is yielded after
+            // them
+            let result = util::invoke_ctx(&self.isolate, &self.context, |c| {
+                fetched = v8::v8_Iterator_Next(c,
+                                               self.iterator.as_raw(),
+                                               self.context.as_raw(),
+                                               self.batch_size as os::raw::c_int,
+                                               raw.as_mut_ptr(),
+                                               &mut done) as usize;
+            });
+            raw.set_len(fetched);
+
+            self.done = done || result.is_err();
+            self.error = result.err();
+        }
+
+        let isolate = &self.isolate;
+        let items = raw.into_iter().map(|item| iterator_item(isolate, item)).collect::<Vec<_>>();
+        self.buffer = items.into_iter();
+    }
+}
+
+impl Iterator for JsIterator {
+    type Item = error::Result<value::ReturnValue>;
+
+    fn next(&mut self) -> Option<error::Result<value::ReturnValue>> {
+        loop {
+            if let Some(item) = self.buffer.next() {
+                return Some(Ok(item));
+            }
+
+            if let Some(error) = self.error.take() {
+                return Some(Err(error));
+            }
+
+            if self.done {
+                return None;
+            }
+
+            self.fetch();
+        }
+    }
+}
+
+/// Returns a new iterator over an iterable object, by calling its `Symbol.iterator` method.
+fn iterator_of(isolate: &isolate::Isolate,
+               context: &context::Context,
+               iterable: &value::Object)
+               -> error::Result<value::Object> {
+    let symbol = value::Symbol::get_iterator(isolate);
+    let method = iterable.get(context, &symbol);
+
+    let iterator = match method.into_function() {
+        Some(method) => try!(method.call_with_this(context, iterable, &[])).into_object(),
+        None => None,
+    };
+
+    match iterator {
+        Some(iterator) => Ok(iterator),
+        None => Err("object is not iterable".into()),
+    }
+}
+
+fn iterator_item(isolate: &isolate::Isolate, item: v8::IteratorItem) -> value::ReturnValue {
+    use v8_sys::PrimitiveReturnValue::*;
+
+    match item.Primitive {
+        PrimitiveReturnValue_Undefined => value::ReturnValue::Undefined,
+        PrimitiveReturnValue_Null => value::ReturnValue::Null,
+        PrimitiveReturnValue_Boolean => value::ReturnValue::Boolean(item.Number != 0.0),
+        PrimitiveReturnValue_Int32 => value::ReturnValue::Int32(item.Number as i32),
+        PrimitiveReturnValue_Uint32 => value::ReturnValue::Uint32(item.Number as u32),
+        PrimitiveReturnValue_Number => value::ReturnValue::Number(item.Number),
+        PrimitiveReturnValue_None => {
+            value::ReturnValue::Value(unsafe { value::Value::from_raw(isolate, item.Value) })
+        }
+    }
+}
+
+impl Chunks {
+    fn new(isolate: &isolate::Isolate,
+           context: &context::Context,
+           array: value::Array,
+           chunk_size: usize)
+           -> Chunks {
+        Chunks {
+            isolate: isolate.clone(),
+            context: context.clone(),
+            array: array,
+            chunk_size: chunk_size,
+            index: 0,
+            buffer: Vec::new().into_iter(),
+            error: None,
+            done: false,
+        }
+    }
+
+    fn next(&mut self) -> Option<error::Result<value::Value>> {
+        loop {
+            if let Some(value) = self.buffer.next() {
+                return Some(Ok(value));
+            }
+
+            // An exception is yielded after the elements that were read before it
+            if let Some(error) = self.error.take() {
+                return Some(Err(error));
+            }
+
+            if self.done {
+                return None;
+            }
+
+            self.fetch();
+        }
+    }
+
+    fn fetch(&mut self) {
+        let mut raw = vec![ptr::null_mut(); self.chunk_size];
+        let mut fetched = 0;
+
+        let result = unsafe {
+            util::invoke_ctx(&self.isolate, &self.context, |c| {
+                fetched = v8::v8_Array_GetRange(c,
+                                                self.array.as_raw(),
+                                                self.context.as_raw(),
+                                                self.index,
+                                                self.chunk_size as os::raw::c_int,
+                                                raw.as_mut_ptr()) as usize;
+            })
+        };
+
+        raw.truncate(fetched);
+        self.index += fetched as u32;
+        self.done = result.is_err() || fetched < self.chunk_size;
+        self.error = result.err();
+
+        let isolate = &self.isolate;
+        let values = raw.into_iter()
+            .map(|r| unsafe { value::Value::from_raw(isolate, r) })
+            .collect::<Vec<_>>();
+        self.buffer = values.into_iter();
+    }
+}
+
+impl Entries {
+    fn new(isolate: &isolate::Isolate,
+           context: &context::Context,
+           collection: &value::Object,
+           arity: usize)
+           -> Entries {
+        let (iterator, error) = match iterator_of(isolate, context, collection) {
+            Ok(iterator) => (Some(iterator), None),
+            Err(error) => (None, Some(error)),
+        };
+
+        Entries {
+            isolate: isolate.clone(),
+            context: context.clone(),
+            iterator: iterator,
+            arity: arity,
+            buffer: Vec::new().into_iter(),
+            error: error,
+            done: false,
+        }
+    }
+
+    fn next(&mut self) -> Option<error::Result<value::Value>> {
+        loop {
+            if let Some(value) = self.buffer.next() {
+                return Some(Ok(value));
+            }
+
+            // An exception is yielded after the entries that were read before it
+            if let Some(error) = self.error.take() {
+                return Some(Err(error));
+            }
+
+            if self.done {
+                return None;
+            }
+
+            self.fetch();
+        }
+    }
+
+    fn fetch(&mut self) {
+        let iterator = match self.iterator {
+            Some(ref iterator) => iterator.as_raw(),
+            None => {
+                self.done = true;
+                return;
+            }
+        };
+
+        let mut raw = vec![ptr::null_mut(); CHUNK_SIZE * self.arity];
+        let mut fetched = 0;
+        let mut done = false;
+
+        let result = unsafe {
+            util::invoke_ctx(&self.isolate, &self.context, |c| {
+                fetched = v8::v8_Iterator_NextValues(c,
+                                                     iterator,
+                                                     self.context.as_raw(),
+                                                     CHUNK_SIZE as os::raw::c_int,
+                                                     self.arity as os::raw::c_int,
+                                                     raw.as_mut_ptr(),
+                                                     &mut done) as usize;
+            })
+        };
+
+        raw.truncate(fetched * self.arity);
+        self.done = done || result.is_err();
+        self.error = result.err();
+
+        let isolate = &self.isolate;
+        let values = raw.into_iter()
+            .map(|r| unsafe { value::Value::from_raw(isolate, r) })
+            .collect::<Vec<_>>();
+        self.buffer = values.into_iter();
+    }
+}
+
+/// Exposes a Rust iterator to Javascript as an iterator object, which is also iterable.
+///
+/// Each call to `next()` from Javascript pulls a single item from the Rust iterator, so the items
+/// are never all held in memory at once.
+pub fn to_iterable<I>(isolate: &isolate::Isolate,
+                      context: &context::Context,
+                      iter: I)
+                      -> value::Object
+    where I: Iterator + 'static,
+          I::Item: ToValue
+{
+    let iter = cell::RefCell::new(iter);
+    let value_key: value::Value = value::String::internalized_from_str(isolate, "value").into();
+    let done_key: value::Value = value::String::internalized_from_str(isolate, "done").into();
+
+    let next = move |info: value::FunctionCallbackInfo| {
+        let context = info.isolate.current_context().unwrap();
+        let item = iter.borrow_mut().next();
+        let done = item.is_none();
+        let value = match item {
+            Some(item) => item.to_value(&info.isolate, &context).into_value(&info.isolate),
+            None => value::undefined(&info.isolate).into(),
+        };
+
+        let result = value::Object::new(&info.isolate, &context);
+        result.set(&context, &value_key, &value);
+        result.set(&context, &done_key, &value::Boolean::new(&info.isolate, done).into());
+        Ok(result.into())
+    };
+
+    let iterator = value::Object::new(isolate, context);
+    let next_key = value::String::internalized_from_str(isolate, "next");
+    let next = value::Function::new(isolate, context, 0, Box::new(next));
+    iterator.set(context, &next_key, &next);
+
+    let iterator_symbol = value::Symbol::get_iterator(isolate);
+    let this = value::Function::new(isolate, context, 0, Box::new(|info| Ok(info.this.into())));
+    iterator.set(context, &iterator_symbol, &this);
+
+    iterator
+}
+
+/// Exposes a Rust iterator to Javascript as an iterator object that pulls items in batches.
+///
+/// The Rust iterator is advanced `batch_size` items at a time, and Javascript then consumes the
+/// batch without calling back into Rust.  This trades a little memory for far fewer transitions
+/// between Javascript and Rust when a script walks a long iterator.
+pub fn to_batched_iterable<I>(isolate: &isolate::Isolate,
+                              context: &context::Context,
+                              iter: I,
+                              batch_size: usize)
+                              -> value::Object
+    where I: Iterator + 'static,
+          I::Item: ToValue
+{
+    assert!(batch_size > 0, "the batch size must be positive");
+
+    let iter = cell::RefCell::new(iter);
+
+    let pull = move |info: value::FunctionCallbackInfo| {
+        let context = info.isolate.current_context().unwrap();
+        let batch = value::Array::new(&info.isolate, &context, 0);
+        let mut iter = iter.borrow_mut();
+
+        for index in 0..batch_size as u32 {
+            match iter.next() {
+                Some(item) => {
+                    let value = item.to_value(&info.isolate, &context).into_value(&info.isolate);
+                    batch.create_data_property_index(&context, index, &value);
+                }
+                None => break,
+            }
+        }
+
+        Ok(batch.into())
+    };
+
+    let pull = value::Function::new(isolate, context, 0, Box::new(pull));
+    let factory = batched_iterator_factory(isolate, context);
+    factory.call(context, &[&pull]).unwrap().into_object().unwrap()
+}
+
+fn batched_iterator_factory(isolate: &isolate::Isolate,
+                            context: &context::Context)
+                            -> value::Function {
+    let cached = context.slot::<BatchedIteratorFactory>().and_then(|factory| factory.0.upgrade());
+
+    if let Some(function) = cached {
+        return function;
+    }
+
+    let source = value::String::from_str(isolate, BATCHED_ITERATOR_SOURCE);
+    let function = script::Script::compile(isolate, context, &source)
+        .and_then(|script| script.run(context))
+        .unwrap()
+        .into_function()
+        .unwrap();
+
+    context.set_slot(BatchedIteratorFactory(weak::Weak::new(isolate, &function)));
+    function
+}
@@ -58,16 +58,28 @@ extern crate num_cpus;
 extern crate v8_sys;
 
 mod allocator;
+mod initialization;
 mod platform;
 #[macro_use]
 mod util;
 
+pub mod affinity;
+pub mod batch;
+pub mod class;
+pub mod clock;
 pub mod context;
 pub mod error;
+pub mod expression;
+pub mod flags;
 pub mod isolate;
+pub mod iter;
+pub mod object_map;
 pub mod script;
 pub mod template;
 pub mod value;
+pub mod wasm;
+pub mod weak;
+pub mod worker;
 
 pub use context::Context;
 pub use isolate::Isolate;
@@ -438,8 +450,9 @@ mod tests {
 
         let error = result.unwrap_err();
         match error.kind() {
-            &error::ErrorKind::Javascript(ref msg, _) => {
-                assert_eq!("Uncaught SyntaxError: Unexpected end of input", msg);
+            &error::ErrorKind::Javascript(ref exception) => {
+                assert_eq!("Uncaught SyntaxError: Unexpected end of input",
+                           exception.message());
             }
             x => panic!("Unexpected error kind: {:?}", x),
         }
@@ -451,8 +464,8 @@ mod tests {
 
         let error = result.unwrap_err();
         match error.kind() {
-            &error::ErrorKind::Javascript(ref msg, _) => {
-                assert_eq!("Uncaught x", msg);
+            &error::ErrorKind::Javascript(ref exception) => {
+                assert_eq!("Uncaught x", exception.message());
             }
             x => panic!("Unexpected error kind: {:?}", x),
         }
@@ -480,12 +493,34 @@ mod tests {
 
         let error = result.unwrap_err();
         match error.kind() {
-            &error::ErrorKind::Javascript(ref msg, ref stack_trace) => {
-                assert_eq!("Uncaught Error: x", msg);
+            &error::ErrorKind::Javascript(ref exception) => {
+                assert_eq!("Uncaught Error: x", exception.message());
                 assert_eq!("    at new w (test.js:13:11)\n    at z (test.js:10:5)\n    at eval \
                             <anon>:1:1\n    at y (test.js:7:5)\n    at x (test.js:4:5)\n    at \
                             test.js:15:3\n    at test.js:16:3\n",
-                           format!("{}", stack_trace));
+                           format!("{}", exception.stack_trace()));
+            }
+            x => panic!("Unexpected error kind: {:?}", x),
+        }
+    }
+
+    #[test]
+    fn eval_exception_value() {
+        let isolate = Isolate::new();
+        let context = Context::new(&isolate);
+        let source = value::String::from_str(&isolate, "throw 42;");
+        let script = Script::compile(&isolate, &context, &source).unwrap();
+
+        let error = script.run(&context).unwrap_err();
+        match error.kind() {
+            &error::ErrorKind::Javascript(ref exception) => {
+                assert_eq!(42, exception.exception().int32_value(&context));
+
+                // A captured exception no longer holds on to the isolate, so it can be sent to
+                // other threads
+                let captured = exception.to_captured();
+                let rendered = ::std::thread::spawn(move || captured.to_string()).join().unwrap();
+                assert!(rendered.contains("Uncaught 42"));
             }
             x => panic!("Unexpected error kind: {:?}", x),
         }
@@ -647,6 +682,827 @@ mod tests {
         assert_eq!(5, result.int32_value(&c));
     }
 
+    #[test]
+    fn run_object_template_instance_accessor() {
+        use std::cell;
+        use std::rc;
+
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let ot = template::ObjectTemplate::new(&i);
+
+        let state = rc::Rc::new(cell::Cell::new(2));
+        let getter_state = state.clone();
+        let setter_state = state.clone();
+        ot.set_accessor("x",
+                        Box::new(move |_, _| Ok(value::ReturnValue::Int32(getter_state.get()))),
+                        Some(Box::new(move |_, value, info| {
+                            let context = info.isolate.current_context().unwrap();
+                            setter_state.set(value.int32_value(&context));
+                            Ok(())
+                        })));
+
+        let o = ot.new_instance(&c);
+        let k = value::String::from_str(&i, "o");
+        c.global().set(&c, &k, &o);
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i, "o.x = o.x + 3; o.x");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let result = script.run(&c).unwrap();
+
+        assert!(result.is_int32());
+        assert_eq!(5, result.int32_value(&c));
+        assert_eq!(5, state.get());
+    }
+
+    #[test]
+    fn run_native_class_method() {
+        use std::cell;
+
+        struct Counter(cell::Cell<i32>);
+
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let class = class::NativeClass::new(&i,
+                                            &c,
+                                            "Counter",
+                                            Box::new(|info| {
+            let c = info.isolate.current_context().unwrap();
+            Ok(Counter(cell::Cell::new(info.args[0].int32_value(&c))))
+        }));
+        class.set_method(&c,
+                         "increment",
+                         Box::new(|counter, info| {
+                             counter.0.set(counter.0.get() + 1);
+                             Ok(value::Integer::new(&info.isolate, counter.0.get()).into())
+                         }));
+
+        let k = value::String::from_str(&i, "Counter");
+        c.global().set(&c, &k, &class.function(&c));
+        let counter = class.wrap(&c, Counter(cell::Cell::new(40)));
+        let k = value::String::from_str(&i, "counter");
+        c.global().set(&c, &k, &counter);
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i,
+                                             "var a = new Counter(1); a.increment(); \
+                                              counter.increment(); counter.increment() + \
+                                              a.increment()");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let result = script.run(&c).unwrap();
+
+        assert_eq!(45, result.int32_value(&c));
+        assert_eq!(42, class.get(&counter).unwrap().0.get());
+        assert!(class.get(&c.global()).is_none());
+
+        let source = value::String::from_str(&i, "Counter.prototype.increment.call({})");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        assert!(script.run(&c).is_err());
+    }
+
+    #[test]
+    #[should_panic="already been instantiated"]
+    fn native_class_method_after_instantiation() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let class = class::NativeClass::new(&i, &c, "Unit", Box::new(|_| Ok(())));
+        class.function(&c);
+        class.set_method(&c,
+                         "late",
+                         Box::new(|_, info| Ok(value::undefined(&info.isolate).into())));
+    }
+
+    #[test]
+    fn weak_handle_finalizer() {
+        use std::cell;
+        use std::rc;
+
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let finalized = rc::Rc::new(cell::Cell::new(false));
+
+        let o = value::Object::new(&i, &c);
+        let finalized_clone = finalized.clone();
+        let weak = weak::Weak::with_finalizer(&i, &o, move || finalized_clone.set(true));
+        assert!(weak.upgrade().is_some());
+
+        drop(o);
+        i.low_memory_notification();
+        assert!(!finalized.get());
+        assert!(weak.is_empty());
+
+        assert_eq!(1, i.run_finalizers());
+        assert!(finalized.get());
+    }
+
+    #[test]
+    fn chunked_iteration() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i,
+                                             "var a = [];
+                                              var m = new Map();
+                                              var s = new Set();
+                                              for (var n = 0; n < 1000; n++) {
+                                                a.push(n);
+                                                m.set(n, n * 2);
+                                                s.add(n * 3);
+                                              }
+                                              var t = [1, 2];
+                                              Object.defineProperty(t, 2, { get: function() { \
+                                                throw 'x'; } });
+                                              var b = new Map();
+                                              b[Symbol.iterator] = function* () { \
+                                                yield [1, 2]; yield 3; };
+                                              [a, m, s, t, b]");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let result = script.run(&c).unwrap().into_object().unwrap();
+
+        let array = result.get_index(&c, 0).into_array().unwrap();
+        assert_eq!(1000, array.length());
+        let sum = array.iter(&c).map(|v| v.unwrap().int32_value(&c)).sum::<i32>();
+        assert_eq!(499500, sum);
+
+        let map = result.get_index(&c, 1).into_map().unwrap();
+        let mut entries = 0;
+        for entry in map.iter(&c) {
+            let (k, v) = entry.unwrap();
+            assert_eq!(k.int32_value(&c) * 2, v.int32_value(&c));
+            entries += 1;
+        }
+        assert_eq!(1000, entries);
+
+        let set = result.get_index(&c, 2).into_set().unwrap();
+        let sum = set.iter(&c).map(|v| v.unwrap().int32_value(&c)).sum::<i32>();
+        assert_eq!(1498500, sum);
+
+        // Elements read before an exception are still yielded
+        let throwing = result.get_index(&c, 3).into_array().unwrap();
+        let items = throwing.iter(&c).collect::<Vec<_>>();
+        assert_eq!(3, items.len());
+        assert!(items[1].is_ok() && items[2].is_err());
+
+        // Malformed entries throw a TypeError, after the entries read before them
+        let malformed = result.get_index(&c, 4).into_map().unwrap();
+        let mut entries = malformed.iter(&c);
+        assert_eq!(2, entries.next().unwrap().unwrap().1.int32_value(&c));
+        match entries.next().unwrap().unwrap_err().kind() {
+            &error::ErrorKind::Javascript(ref exception) => {
+                assert!(exception.message().contains("TypeError"));
+            }
+            x => panic!("Unexpected error kind: {:?}", x),
+        }
+        assert!(entries.next().is_none());
+    }
+
+    #[test]
+    fn rust_iterator_as_iterable() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+
+        let single = iter::to_iterable(&i, &c, (1..4).map(|n| n * 10));
+        let batched = iter::to_batched_iterable(&i, &c, (1..6).map(|n| n as f64 / 2.0), 2);
+
+        let k = value::String::from_str(&i, "single");
+        c.global().set(&c, &k, &single);
+        let k = value::String::from_str(&i, "batched");
+        c.global().set(&c, &k, &batched);
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i,
+                                             "var result = [];
+                                              for (var x of single) result.push(x);
+                                              for (var y of batched) result.push(y);
+                                              result.join()");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let result = script.run(&c).unwrap();
+
+        assert_eq!("10,20,30,0.5,1,1.5,2,2.5", result.to_string(&c).value());
+    }
+
+    #[test]
+    fn js_generator_from_rust() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i,
+                                             "(function* () {
+                                                for (var n = 0; n < 600; n++) yield n;
+                                                yield 'end';
+                                              })()");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let generator = script.run(&c).unwrap().into_object().unwrap();
+
+        let mut sum = 0;
+        let mut last = None;
+        for item in iter::JsIterator::from_iterable(&i, &c, &generator).unwrap() {
+            match item.unwrap() {
+                value::ReturnValue::Int32(n) => sum += n,
+                value::ReturnValue::Value(v) => last = Some(v.to_string(&c).value()),
+                other => panic!("unexpected item {:?}", other),
+            }
+        }
+
+        assert_eq!(179700, sum);
+        assert_eq!(Some("end".to_owned()), last);
+
+        // Items produced before the generator throws are not lost
+        let source = value::String::from_str(&i,
+                                             "(function* () { yield 1; yield 2; throw 'x'; })()");
+        let generator = Script::compile_with_name(&i, &c, &name, &source)
+            .unwrap()
+            .run(&c)
+            .unwrap()
+            .into_object()
+            .unwrap();
+        let items = iter::JsIterator::from_iterable(&i, &c, &generator)
+            .unwrap()
+            .collect::<Vec<_>>();
+        assert_eq!(3, items.len());
+        assert!(items[1].is_ok() && items[2].is_err());
+    }
+
+    #[test]
+    fn object_map_weak_keys() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let mut map = object_map::JsObjectMap::with_weak_keys(&i);
+
+        let a = value::Object::new(&i, &c);
+        let b = value::Object::new(&i, &c);
+        assert_eq!(None, map.insert(&a, "a"));
+        assert_eq!(None, map.insert(&b, "b"));
+        assert_eq!(Some("b"), map.insert(&b, "b2"));
+        assert_eq!(Some(&"a"), map.get(&a));
+        assert_eq!(Some(&"b2"), map.get(&b));
+        assert!(!map.contains_key(&value::Object::new(&i, &c)));
+        assert_eq!(2, map.len());
+
+        drop(b);
+        i.low_memory_notification();
+        i.run_finalizers();
+        assert_eq!(1, map.evict_collected());
+        assert_eq!(1, map.len());
+        assert_eq!(Some("a"), map.remove(&a));
+        assert!(map.is_empty());
+    }
+
+    #[test]
+    fn external_allocated_memory() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let base = i.adjust_amount_of_external_allocated_memory(0);
+
+        let class = class::NativeClass::new(&i, &c, "Buffer", Box::new(|_| Ok(vec![0u8; 1024])));
+        class.set_external_size(Box::new(|buffer| buffer.len()));
+        let buffer = class.wrap(&c, vec![0u8; 4096]);
+        assert_eq!(base + 4096, i.adjust_amount_of_external_allocated_memory(0));
+
+        drop(buffer);
+        i.low_memory_notification();
+        assert_eq!(base, i.adjust_amount_of_external_allocated_memory(0));
+    }
+
+    #[test]
+    fn array_source_dropped_with_template() {
+        use std::cell;
+        use std::rc;
+
+        struct Source(rc::Rc<cell::Cell<bool>>);
+
+        impl template::ArraySource for Source {
+            fn len(&self) -> u32 {
+                1
+            }
+
+            fn get(&self, _: &Isolate, _: u32) -> value::ReturnValue {
+                value::ReturnValue::Int32(7)
+            }
+        }
+
+        impl Drop for Source {
+            fn drop(&mut self) {
+                self.0.set(true);
+            }
+        }
+
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let dropped = rc::Rc::new(cell::Cell::new(false));
+
+        let ot = template::ObjectTemplate::new(&i);
+        ot.set_array_like(Source(dropped.clone()));
+        let o = ot.new_instance(&c);
+        assert_eq!(7, o.get_index(&c, 0).int32_value(&c));
+
+        drop(o);
+        drop(ot);
+        drop(c);
+        i.low_memory_notification();
+        assert!(dropped.get());
+    }
+
+    #[test]
+    fn object_template_array_like() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let ot = template::ObjectTemplate::new(&i);
+        ot.set_array_like(vec![10, 20, 30]);
+
+        let o = ot.new_instance(&c);
+        let k = value::String::from_str(&i, "o");
+        c.global().set(&c, &k, &o);
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i,
+                                             "o[1] = 0; \
+                                              [o.length, o[0] + o[1] + o[2], 2 in o, 3 in o, \
+                                               Object.keys(o).length].join()");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let result = script.run(&c).unwrap();
+
+        assert_eq!("3,60,true,false,3", result.to_string(&c).value());
+    }
+
+    #[test]
+    fn object_template_map_like() {
+        use std::collections;
+        use std::rc;
+
+        let i = Isolate::new();
+        let c = Context::new(&i);
+
+        let mut inner = collections::HashMap::new();
+        inner.insert("x".to_owned(), Some(1.5));
+        inner.insert("y".to_owned(), None);
+        let mut outer = collections::HashMap::new();
+        outer.insert("point".to_owned(), rc::Rc::new(inner));
+
+        let ot = template::ObjectTemplate::new(&i);
+        ot.set_map_like(outer);
+
+        let o = ot.new_instance(&c);
+        let k = value::String::from_str(&i, "o");
+        c.global().set(&c, &k, &o);
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i,
+                                             "o.point = 1; o.extra = 2; \
+                                              [o.point.x, o.point.y, 'z' in o.point, o.extra, \
+                                               o.point === o.point, \
+                                               Object.keys(o.point).sort()].join()");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let result = script.run(&c).unwrap();
+
+        assert_eq!("1.5,,false,2,true,x,y", result.to_string(&c).value());
+    }
+
+    #[test]
+    fn isolate_template_registry() {
+        use std::cell;
+
+        thread_local!(static BUILDS: cell::Cell<usize> = cell::Cell::new(0));
+
+        struct Adder;
+
+        impl template::IsolateTemplate for Adder {
+            type Template = template::FunctionTemplate;
+
+            fn build(isolate: &Isolate, context: &Context) -> template::FunctionTemplate {
+                BUILDS.with(|b| b.set(b.get() + 1));
+                template::FunctionTemplate::new(isolate, context, Box::new(test_function))
+            }
+        }
+
+        let i = Isolate::new();
+        let c1 = Context::new(&i);
+        let c2 = Context::new(&i);
+
+        let f1 = i.template::<Adder>(&c1).get_function(&c1);
+        let f2 = i.template::<Adder>(&c1).get_function(&c1);
+        let f3 = i.template::<Adder>(&c2).get_function(&c2);
+
+        assert_eq!(1, BUILDS.with(|b| b.get()));
+        assert!(f1.strict_equals(&f2));
+        assert!(!f1.strict_equals(&f3));
+
+        let p1 = value::Integer::new(&i, 2);
+        let p2 = value::Integer::new(&i, 3);
+        let result = f3.call(&c2, &[&p1, &p2]).unwrap();
+        assert_eq!(5, result.int32_value(&c2));
+    }
+
+    #[test]
+    fn primitive_conversions() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+
+        let smi: value::Value = value::Integer::new(&i, -7).into();
+        assert_eq!(-7, smi.int32_value(&c));
+        assert_eq!(-7, smi.integer_value(&c));
+        assert_eq!(-7.0, smi.number_value(&c));
+        assert_eq!(true, smi.boolean_value(&c));
+        assert_eq!(4294967289, smi.uint32_value(&c));
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i, "[2.5, { valueOf() { throw 'nope'; } }]");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let values = script.run(&c).unwrap().into_object().unwrap();
+
+        assert_eq!(2.5, values.get_index(&c, 0).try_number_value(&c).unwrap());
+        assert!(values.get_index(&c, 1).try_number_value(&c).is_err());
+    }
+
+    #[test]
+    fn entered_context_batch() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let other = Context::new(&i);
+        let k = value::String::from_str(&i, "n");
+
+        {
+            let _entered = c.enter_sticky();
+            let global = c.global();
+
+            for n in 0..100 {
+                global.set(&c, &k, &value::Integer::new(&i, n));
+            }
+
+            // Other contexts are still entered per call
+            other.global().set(&other, &k, &value::Integer::new(&i, -1));
+
+            {
+                let _nested = other.enter_sticky();
+                let clone = c.clone();
+                assert_eq!(99, clone.global().get(&clone, &k).int32_value(&clone));
+            }
+
+            // A bound context takes over until its guard is dropped
+            {
+                let _bound = other.make_current();
+                let source = value::String::from_str(&i, "n");
+                let result = Script::compile(&i, &c, &source).unwrap().run(&c).unwrap();
+                assert_eq!(99, result.int32_value(&c));
+            }
+        }
+
+        assert_eq!(99, c.global().get(&c, &k).int32_value(&c));
+        assert_eq!(-1, other.global().get(&other, &k).int32_value(&other));
+    }
+
+    #[test]
+    fn batch_run_rules() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+
+        let compile = |source: &str| {
+            let source = value::String::from_str(&i, source);
+            Script::compile(&i, &c, &source).unwrap()
+        };
+
+        let rules = [compile("(function (x) { return x > 3; })"),
+                     compile("(function (x) { return x.missing.field; })"),
+                     compile("(function (x) { return x * 2; })")];
+        let functions = rules.iter()
+            .map(|rule| rule.run(&c).unwrap().into_function().unwrap())
+            .collect::<Vec<_>>();
+        let tasks = functions.iter().map(|f| batch::Task::Function(f)).collect::<Vec<_>>();
+        let arg: value::Value = value::Integer::new(&i, 5).into();
+
+        let results = batch::run(&i, &c, &tasks, &[&arg], batch::Output::String);
+        assert_eq!(3, results.len());
+        assert_eq!(Some(batch::Item::String("true")), results.get(0).ok());
+        assert!(results.get(1).is_err());
+        assert_eq!(Some(batch::Item::String("10")), results.get(2).ok());
+
+        let script = compile("1 + 1");
+        let results = batch::run(&i,
+                                 &c,
+                                 &[batch::Task::Script(&script)],
+                                 &[],
+                                 batch::Output::Number);
+        assert_eq!(Some(batch::Item::Number(2.0)), results.get(0).ok());
+    }
+
+    #[test]
+    fn expression_cache_lru() {
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let mut cache = expression::ExpressionCache::new(&i, &c, &["a", "b"]);
+        cache.set_max_entries(2);
+
+        assert_eq!(5, cache.evaluate("a + b", &[&2, &3]).unwrap().int32_value(&c));
+        assert_eq!(6, cache.evaluate("a * b", &[&2, &3]).unwrap().int32_value(&c));
+        assert_eq!(9, cache.evaluate("a + b", &[&4, &5]).unwrap().int32_value(&c));
+        assert!(cache.evaluate("a - b // comment", &[&2, &3]).unwrap().boolean_value(&c));
+        assert!(cache.evaluate("a +", &[]).is_err());
+
+        let stats = cache.stats();
+        assert_eq!(2, cache.len());
+        assert_eq!(1, stats.hits);
+        assert_eq!(4, stats.misses);
+        assert_eq!(1, stats.evictions);
+        assert_eq!(0.2, stats.hit_rate());
+    }
+
+    #[test]
+    fn wasm_module_cache() {
+        // An empty module, in the pre-release binary format understood by this V8 generation
+        let bytes = [0x00, 0x61, 0x73, 0x6d, 0x0b, 0x00, 0x00, 0x00];
+
+        wasm::expose();
+        let isolate = Isolate::new();
+        let context = Context::new(&isolate);
+
+        let directory = ::std::env::temp_dir().join("v8-rs-wasm-module-cache-test");
+        let _ = ::std::fs::remove_dir_all(&directory);
+        let mut cache = wasm::ModuleCache::new(directory.clone());
+
+        let module = cache.load(&isolate, &context, &bytes).unwrap();
+        let imports = wasm::Imports::new(&isolate, &context);
+        module.instantiate(&context, &imports).unwrap();
+
+        let restored = wasm::WasmModule::deserialize(&isolate, &module.serialize()).unwrap();
+        restored.instantiate(&context, &imports).unwrap();
+
+        cache.load(&isolate, &context, &bytes).unwrap();
+        assert_eq!(wasm::Stats { hits: 1, misses: 1 }, cache.stats());
+
+        // An entry stored for other bytes under the same name is a miss, as on a hash collision
+        for entry in ::std::fs::read_dir(&directory).unwrap() {
+            let path = entry.unwrap().path();
+            let mut stored = Vec::new();
+            let mut file = ::std::fs::File::open(&path).unwrap();
+            ::std::io::Read::read_to_end(&mut file, &mut stored).unwrap();
+            stored[12] ^= 0xff;
+            let mut file = ::std::fs::File::create(&path).unwrap();
+            ::std::io::Write::write_all(&mut file, &stored).unwrap();
+        }
+
+        cache.load(&isolate, &context, &bytes).unwrap();
+        assert_eq!(wasm::Stats { hits: 1, misses: 2 }, cache.stats());
+
+        assert!(wasm::WasmModule::compile(&isolate, &context, &[1, 2, 3]).is_err());
+
+        ::std::fs::remove_dir_all(&directory).unwrap();
+    }
+
+    #[test]
+    fn wasm_memory_view() {
+        wasm::expose();
+        let isolate = Isolate::new();
+        let context = Context::new(&isolate);
+
+        let mut memory = wasm::WasmMemory::new(&isolate, &context, 1, Some(2)).unwrap();
+
+        memory.with_view(|view| {
+                assert_eq!(wasm::PAGE_SIZE, view.len());
+                view.write_u32(3, 0xdeadbeef).unwrap();
+                view.write_f64(16, 2.5).unwrap();
+                assert_eq!(0xef, view[3]);
+                assert_eq!(0xdeadbeef, view.read_u32(3).unwrap());
+                assert_eq!(2.5, view.read_f64(16).unwrap());
+                assert!(view.read_u32(wasm::PAGE_SIZE - 2).is_err());
+            })
+            .unwrap();
+
+        assert_eq!(1, memory.grow(1).unwrap());
+        assert!(memory.grow(1).is_err());
+
+        let word = memory.with_view(|view| {
+                assert_eq!(2 * wasm::PAGE_SIZE, view.len());
+                assert_eq!(0, view.read_u64(wasm::PAGE_SIZE).unwrap());
+                view.read_u32(3).unwrap()
+            })
+            .unwrap();
+        assert_eq!(0xdeadbeef, word);
+
+        // Growing an empty memory behind the back of the wrapper is noticed as well
+        let mut empty = wasm::WasmMemory::new(&isolate, &context, 0, None).unwrap();
+        assert_eq!(0, empty.byte_length().unwrap());
+
+        let key = value::String::from_str(&isolate, "grow");
+        let grow = empty.as_object().get(&context, &key).into_function().unwrap();
+        let delta: value::Value = value::Integer::new(&isolate, 1).into();
+        grow.call_with_this(&context, empty.as_object(), &[&delta]).unwrap();
+        assert_eq!(wasm::PAGE_SIZE, empty.byte_length().unwrap());
+    }
+
+    #[test]
+    fn affinity_topology() {
+        let topology = affinity::Topology::single_node(4);
+        assert_eq!(1, topology.nodes().len());
+        assert_eq!(Some(0), topology.node_of_cpu(3).map(|node| node.id()));
+        assert_eq!(None, topology.node_of_cpu(4));
+
+        let topology = affinity::Topology::from_nodes(vec![vec![0, 1], vec![], vec![2, 3]]);
+        let ids = topology.nodes().iter().map(|node| node.id()).collect::<Vec<_>>();
+        assert_eq!(vec![0, 2], ids);
+        assert_eq!(4, topology.cpu_count());
+        assert!(affinity::Topology::detect().cpu_count() > 0);
+    }
+
+    #[test]
+    fn flag_presets() {
+        assert_eq!(vec!["--min_semi_space_size=1",
+                        "--max_semi_space_size=1",
+                        "--optimize_for_size"],
+                   flags::Flags::preset(flags::Preset::LowMemory).to_args());
+        assert_eq!(vec!["--lazy", "--noconcurrent_recompilation"],
+                   flags::Flags::preset(flags::Preset::Startup).to_args());
+
+        let presets = [flags::Preset::LowMemory, flags::Preset::Throughput, flags::Preset::Startup];
+        for preset in &presets {
+            assert_eq!(*preset, preset.name().parse().unwrap());
+            flags::Flags::preset(*preset).validate().unwrap();
+        }
+
+        let inverted = flags::Flags::new().min_semi_space_size(8).max_semi_space_size(4);
+        assert!(inverted.validate().is_err());
+        assert!(flags::Flags::new().raw("trace_gc").validate().is_err());
+        assert!(flags::Flags::new().raw("--stack_trace_limit=50").validate().is_ok());
+        assert!(flags::Flags::new().raw("--trace_gc --expose_gc").validate().is_err());
+        assert!(flags::Flags::new().raw("--stack_trace_limit=5 0").validate().is_err());
+
+        Isolate::new();
+        assert!(flags::configure(&flags::Flags::preset(flags::Preset::Throughput)).is_err());
+        assert!(!flags::passed_flags().contains(&"--max_semi_space_size=32".to_owned()));
+    }
+
+    #[test]
+    fn virtual_clock() {
+        use std::sync;
+        use std::sync::atomic;
+
+        // Other tests initialize V8 on the clock of the host, so only the real time mode can be
+        // exercised here; tests/virtual_time.rs covers virtual time
+        let isolate = Isolate::new();
+        assert!(clock::use_virtual_time(clock::BackgroundTasks::Queued).is_err());
+        assert!(!clock::is_virtual());
+        assert!(clock::advance(::std::time::Duration::from_millis(10)).is_err());
+
+        let before = clock::now();
+        assert!(clock::now() >= before);
+        assert_eq!(0, clock::pending_background_tasks());
+        assert_eq!(0, clock::run_background_tasks());
+
+        let ran = sync::Arc::new(atomic::AtomicBool::new(false));
+        let task_ran = ran.clone();
+        isolate.post_task(::std::time::Duration::new(0, 0),
+                          Box::new(move || task_ran.store(true, atomic::Ordering::SeqCst)));
+        isolate.run_enqueued_tasks();
+        assert!(ran.load(atomic::Ordering::SeqCst));
+    }
+
+    #[test]
+    fn worker_messages() {
+        let pool = worker::WorkerPool::new(2);
+        let tenant = pool.tenant(1);
+
+        let isolate = Isolate::new();
+        let context = Context::new(&isolate);
+        worker::install(&isolate, &context, &tenant);
+
+        let source = value::String::from_str(&isolate,
+                                             "var results = [];\n\
+                                              var w = new Worker('onmessage = function(e) { \
+                                              var d = e.data; \
+                                              var a = new Uint8Array(d.buffer); \
+                                              postMessage({ sum: a[0] + a[1], \
+                                              shared: d.a === d.b && d.self === d }); \
+                                              close(); };');\n\
+                                              w.onmessage = function(e) { \
+                                              results.push(e.data.sum, e.data.shared); };\n\
+                                              var buffer = new ArrayBuffer(2);\n\
+                                              new Uint8Array(buffer).set([3, 4]);\n\
+                                              var o = {};\n\
+                                              var m = { buffer: buffer, a: o, b: o };\n\
+                                              m.self = m;\n\
+                                              w.postMessage(m, [buffer]);\n\
+                                              var detached = buffer.byteLength;\n\
+                                              var other = new ArrayBuffer(1);\n\
+                                              var duplicated;\n\
+                                              try { w.postMessage(other, [other, other]); } \
+                                              catch (e) { duplicated = e.message; }\n\
+                                              var intact = other.byteLength;\n\
+                                              var refused;\n\
+                                              try { new Worker(''); } \
+                                              catch (e) { refused = e.message; }");
+        Script::compile(&isolate, &context, &source).unwrap().run(&context).unwrap();
+
+        let get = |name: &str| {
+            let key = value::String::from_str(&isolate, name);
+            context.global().get(&context, &key)
+        };
+
+        assert_eq!(0, get("detached").int32_value(&context));
+        assert!(get("duplicated").to_string(&context).value().contains("more than once"));
+        assert_eq!(1, get("intact").int32_value(&context));
+        assert!(get("refused").to_string(&context).value().contains("too many workers"));
+
+        let results = get("results").into_array().unwrap();
+        let deadline = ::std::time::Instant::now() + ::std::time::Duration::from_secs(10);
+        while results.length() == 0 && ::std::time::Instant::now() < deadline {
+            worker::dispatch(&isolate, &context).unwrap();
+            ::std::thread::sleep(::std::time::Duration::from_millis(1));
+        }
+
+        assert_eq!(7, results.get_index(&context, 0).int32_value(&context));
+        assert!(results.get_index(&context, 1).boolean_value(&context));
+    }
+
+    #[test]
+    fn lazy_global_property() {
+        use std::cell;
+        use std::rc;
+
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        let calls = rc::Rc::new(cell::Cell::new(0));
+
+        for name in &["used", "unused"] {
+            let calls = calls.clone();
+            let key = value::String::from_str(&i, name);
+            c.global().set_lazy_data_property(&c,
+                                              &key,
+                                              Box::new(move |info: value::PropertyCallbackInfo| {
+                                                  calls.set(calls.get() + 1);
+                                                  Ok(value::Integer::new(&info.isolate, 21)
+                                                      .into())
+                                              }));
+        }
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i, "used + used");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let result = script.run(&c).unwrap();
+
+        assert_eq!(42, result.int32_value(&c));
+        assert_eq!(1, calls.get());
+    }
+
+    #[test]
+    fn lazy_global_template() {
+        use std::cell;
+        use std::rc;
+
+        let i = Isolate::new();
+        let global = template::ObjectTemplate::new(&i);
+        let calls = rc::Rc::new(cell::Cell::new(0));
+
+        for n in 0..200 {
+            let calls = calls.clone();
+            global.set_lazy_data_property(&format!("helper{}", n),
+                                          Box::new(move |info: value::PropertyCallbackInfo| {
+                                              calls.set(calls.get() + 1);
+                                              Ok(value::Integer::new(&info.isolate, n).into())
+                                          }));
+        }
+
+        for _ in 0..50 {
+            let c = Context::new_with_global_template(&i, &global);
+            let source = value::String::from_str(&i, "helper7 + helper7");
+            let result = Script::compile(&i, &c, &source).unwrap().run(&c).unwrap();
+            assert_eq!(14, result.int32_value(&c));
+        }
+
+        // Every context initializes only the helper that it uses, and only once
+        assert_eq!(50, calls.get());
+    }
+
+    #[test]
+    fn context_slot() {
+        struct RequestId(u32);
+
+        let i = Isolate::new();
+        let c = Context::new(&i);
+        assert!(c.slot::<RequestId>().is_none());
+        c.set_slot(RequestId(7));
+        assert_eq!(7, c.slot::<RequestId>().unwrap().0);
+
+        let f = value::Function::new(&i,
+                                     &c,
+                                     0,
+                                     Box::new(|info| {
+            let id = Context::current_slot::<RequestId>(&info.isolate).unwrap();
+            Ok(value::Integer::new(&info.isolate, id.0 as i32).into())
+        }));
+
+        let k = value::String::from_str(&i, "requestId");
+        c.global().set(&c, &k, &f);
+
+        let name = value::String::from_str(&i, "test.js");
+        let source = value::String::from_str(&i, "requestId()");
+        let script = Script::compile_with_name(&i, &c, &name, &source).unwrap();
+        let result = script.run(&c).unwrap();
+
+        assert_eq!(7, result.int32_value(&c));
+    }
+
     #[test]
     fn isolate_rc() {
         let (f, c, p) = {
@@ -796,4 +1652,22 @@ mod benches {
 
         bencher.iter(|| function.call(&context, &[&param]).unwrap());
     }
+
+    #[bench]
+    fn property_get_entered(bencher: &mut test::Bencher) {
+        let isolate = Isolate::new();
+        let context = Context::new(&isolate);
+        let global = context.global();
+        let key = value::String::from_str(&isolate, "Object");
+        let _entered = context.enter_sticky();
+
+        bencher.iter(|| global.get(&context, &key));
+    }
+
+    #[bench]
+    fn value_handle_create(bencher: &mut test::Bencher) {
+        let isolate = Isolate::new();
+
+        bencher.iter(|| value::Integer::new(&isolate, 42));
+    }
 }
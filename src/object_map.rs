@@ -0,0 +1,212 @@
+//! Rust-side maps keyed by the identity of Javascript objects.
+//!
+//! A [`JsObjectMap`](struct.JsObjectMap.html) associates Rust data with Javascript objects without
+//! touching the objects themselves.  Entries are hashed on the identity hash that V8 assigns to
+//! every object, and the rare collisions are resolved by comparing the objects with
+//! `strict_equals`, so a lookup usually takes two calls into V8: one for the hash, and one per
+//! candidate in the bucket.
+//!
+//! By default, the map keeps its keys alive.  A map created with `with_weak_keys` instead lets the
+//! keys be garbage collected, and evicts the entries of collected keys once the finalizers of the
+//! isolate have run (see `Isolate::run_finalizers`).  Weak keys make lookups more expensive: each
+//! candidate has to be upgraded to a strong handle before it can be compared, which takes another
+//! call into V8 and creates (and later destroys) a persistent handle.
+use isolate;
+use value;
+use weak;
+use std::cell;
+use std::collections;
+use std::mem;
+use std::rc;
+
+/// A map from Javascript objects (by identity) to Rust values.
+pub struct JsObjectMap<V> {
+    isolate: isolate::Isolate,
+    weak_keys: bool,
+    buckets: collections::HashMap<u32, Vec<Entry<V>>>,
+    len: usize,
+    collected: rc::Rc<cell::Cell<usize>>,
+}
+
+struct Entry<V> {
+    key: Key,
+    value: V,
+}
+
+enum Key {
+    Strong(value::Object),
+    Weak(weak::Weak<value::Object>),
+}
+
+impl<V> JsObjectMap<V> {
+    /// Creates a new empty map that keeps its keys alive.
+    pub fn new(isolate: &isolate::Isolate) -> JsObjectMap<V> {
+        JsObjectMap::new_inner(isolate, false)
+    }
+
+    /// Creates a new empty map that does not keep its keys alive.
+    ///
+    /// The entry of a key is evicted some time after the key has been garbage collected.
+    pub fn with_weak_keys(isolate: &isolate::Isolate) -> JsObjectMap<V> {
+        JsObjectMap::new_inner(isolate, true)
+    }
+
+    fn new_inner(isolate: &isolate::Isolate, weak_keys: bool) -> JsObjectMap<V> {
+        JsObjectMap {
+            isolate: isolate.clone(),
+            weak_keys: weak_keys,
+            buckets: collections::HashMap::new(),
+            len: 0,
+            collected: rc::Rc::new(cell::Cell::new(0)),
+        }
+    }
+
+    /// The number of entries in the map.
+    ///
+    /// For a map with weak keys, this includes entries whose keys have been collected but not yet
+    /// evicted, so it is only an upper bound on the number of live entries until
+    /// `evict_collected` has been called.  Inserting and removing entries evicts as well.
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Whether the map has no entries.
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    /// Inserts a value for the specified key, returning the previous value of the key if there was
+    /// one.
+    pub fn insert(&mut self, key: &value::Object, value: V) -> Option<V> {
+        self.evict_collected();
+
+        let hash = key.get_identity_hash();
+
+        if let Some(entry) = self.find_mut(hash, key) {
+            return Some(mem::replace(&mut entry.value, value));
+        }
+
+        let key = if self.weak_keys {
+            let collected = self.collected.clone();
+            Key::Weak(weak::Weak::with_finalizer(&self.isolate,
+                                                 key,
+                                                 move || collected.set(collected.get() + 1)))
+        } else {
+            Key::Strong(key.clone())
+        };
+
+        self.buckets.entry(hash).or_insert_with(Vec::new).push(Entry {
+            key: key,
+            value: value,
+        });
+        self.len += 1;
+        None
+    }
+
+    /// Returns the value of the specified key.
+    pub fn get(&self, key: &value::Object) -> Option<&V> {
+        let hash = key.get_identity_hash();
+
+        self.buckets
+            .get(&hash)
+            .and_then(|bucket| bucket.iter().find(|entry| entry.key.is(key)))
+            .map(|entry| &entry.value)
+    }
+
+    /// Returns a mutable reference to the value of the specified key.
+    pub fn get_mut(&mut self, key: &value::Object) -> Option<&mut V> {
+        let hash = key.get_identity_hash();
+        self.find_mut(hash, key).map(|entry| &mut entry.value)
+    }
+
+    /// Whether the map has an entry for the specified key.
+    pub fn contains_key(&self, key: &value::Object) -> bool {
+        self.get(key).is_some()
+    }
+
+    /// Removes the entry of the specified key, returning its value if there was one.
+    pub fn remove(&mut self, key: &value::Object) -> Option<V> {
+        self.evict_collected();
+
+        let hash = key.get_identity_hash();
+        let removed = match self.buckets.get_mut(&hash) {
+            Some(bucket) => {
+                bucket.iter()
+                    .position(|entry| entry.key.is(key))
+                    .map(|index| bucket.swap_remove(index).value)
+            }
+            None => None,
+        };
+
+        if removed.is_some() {
+            self.len -= 1;
+
+            if self.buckets.get(&hash).map_or(false, |bucket| bucket.is_empty()) {
+                self.buckets.remove(&hash);
+            }
+        }
+
+        removed
+    }
+
+    /// Removes all entries from the map.
+    pub fn clear(&mut self) {
+        self.buckets.clear();
+        self.len = 0;
+    }
+
+    /// Evicts the entries whose keys have been garbage collected, returning the number of evicted
+    /// entries.
+    ///
+    /// This happens automatically on `insert` and `remove`, but can be called explicitly to
+    /// release the values of collected keys earlier.
+    pub fn evict_collected(&mut self) -> usize {
+        if self.collected.get() == 0 {
+            return 0;
+        }
+
+        self.collected.set(0);
+
+        let before = self.len;
+
+        let mut empty = Vec::new();
+
+        for (hash, bucket) in self.buckets.iter_mut() {
+            bucket.retain(|entry| !entry.key.is_collected());
+
+            if bucket.is_empty() {
+                empty.push(*hash);
+            }
+        }
+
+        for hash in empty {
+            self.buckets.remove(&hash);
+        }
+
+        self.len = self.buckets.values().map(|bucket| bucket.len()).sum();
+
+        before - self.len
+    }
+
+    fn find_mut(&mut self, hash: u32, key: &value::Object) -> Option<&mut Entry<V>> {
+        self.buckets
+            .get_mut(&hash)
+            .and_then(|bucket| bucket.iter_mut().find(|entry| entry.key.is(key)))
+    }
+}
+
+impl Key {
+    fn is(&self, object: &value::Object) -> bool {
+        match *self {
+            Key::Strong(ref key) => key.strict_equals(object),
+            Key::Weak(ref key) => key.upgrade().map_or(false, |key| key.strict_equals(object)),
+        }
+    }
+
+    fn is_collected(&self) -> bool {
+        match *self {
+            Key::Strong(_) => false,
+            Key::Weak(ref key) => key.is_empty(),
+        }
+    }
+}
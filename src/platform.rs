@@ -1,13 +1,38 @@
 use v8_sys as v8;
+use std::collections;
+use std::os;
+use std::panic;
+use std::sync;
+use std::sync::mpsc;
 use std::thread;
 use std::time;
 use num_cpus;
+use affinity;
+use clock;
 use isolate;
 
+static VIRTUAL_TIME: sync::atomic::AtomicBool = sync::atomic::ATOMIC_BOOL_INIT;
+
 lazy_static! {
     static ref START_TIME: time::Instant = {
         time::Instant::now()
     };
+
+    /// Pools of background threads pinned to each NUMA node, created when a task is first posted
+    /// from a thread pinned to that node.
+    static ref NODE_POOLS: sync::Mutex<collections::HashMap<usize, mpsc::Sender<Task>>> = {
+        sync::Mutex::new(collections::HashMap::new())
+    };
+
+    /// The clock and background task queue that are used instead of the host once virtual time
+    /// has been enabled.
+    static ref VIRTUAL_CLOCK: sync::Mutex<VirtualClock> = {
+        sync::Mutex::new(VirtualClock {
+            now: time::Duration::new(0, 0),
+            background_tasks: clock::BackgroundTasks::Inline,
+            queue: collections::VecDeque::new(),
+        })
+    };
 }
 
 /// A simple platform implementation that uses global OS threads for
@@ -25,6 +50,16 @@ unsafe impl Send for Task {}
 #[derive(Debug, Eq, Ord, PartialEq, PartialOrd)]
 pub struct IdleTask(v8::IdleTaskPtr);
 
+/// The work of a task that was created from Rust.
+pub type Closure = Box<FnMut() + Send + 'static>;
+
+#[derive(Debug)]
+struct VirtualClock {
+    now: time::Duration,
+    background_tasks: clock::BackgroundTasks,
+    queue: collections::VecDeque<Task>,
+}
+
 impl Platform {
     pub fn new() -> Platform {
         let raw = unsafe { v8::v8_Platform_Create(PLATFORM_FUNCTIONS) };
@@ -50,6 +85,12 @@ impl Drop for Platform {
 }
 
 impl Task {
+    /// Creates a task that runs the specified closure.
+    pub fn new(closure: Closure) -> Task {
+        let data = Box::into_raw(Box::new(closure)) as *mut os::raw::c_void;
+        Task(unsafe { v8::v8_Task_New(Some(run_closure), Some(destroy_closure), data) })
+    }
+
     pub fn run(&self) {
         unsafe {
             v8::v8_Task_Run(self.0);
@@ -96,13 +137,92 @@ extern "C" fn destroy_platform() {
     // No-op
 }
 
+/// Switches the platform to virtual time.  Must be called before V8 is initialized.
+pub fn enable_virtual_time(background_tasks: clock::BackgroundTasks) {
+    VIRTUAL_CLOCK.lock().unwrap().background_tasks = background_tasks;
+    VIRTUAL_TIME.store(true, sync::atomic::Ordering::SeqCst);
+}
+
+pub fn is_virtual_time() -> bool {
+    VIRTUAL_TIME.load(sync::atomic::Ordering::SeqCst)
+}
+
+/// The time since the platform clock started, virtual or not.
+pub fn now() -> time::Duration {
+    if is_virtual_time() {
+        VIRTUAL_CLOCK.lock().unwrap().now
+    } else {
+        START_TIME.elapsed()
+    }
+}
+
+/// Advances virtual time, returning `false` if the platform runs on the clock of the host.
+pub fn advance_virtual_time(duration: time::Duration) -> bool {
+    if !is_virtual_time() {
+        return false;
+    }
+
+    let mut state = VIRTUAL_CLOCK.lock().unwrap();
+    state.now = state.now + duration;
+    true
+}
+
+/// Runs the oldest queued background task, if there is one.
+pub fn run_queued_background_task() -> bool {
+    // The lock must not be held while the task runs, since it may post further tasks
+    let task = VIRTUAL_CLOCK.lock().unwrap().queue.pop_front();
+
+    match task {
+        Some(task) => {
+            task.run();
+            true
+        }
+        None => false,
+    }
+}
+
+pub fn queued_background_tasks() -> usize {
+    VIRTUAL_CLOCK.lock().unwrap().queue.len()
+}
+
 extern "C" fn number_of_available_background_threads() -> usize {
-    num_cpus::get()
+    // In virtual time, V8 should not size its work by a number that differs between hosts
+    if is_virtual_time() {
+        1
+    } else {
+        num_cpus::get()
+    }
 }
 
 extern "C" fn call_on_background_thread(task: v8::TaskPtr,
                                         _expected_runtime: v8::v8_ExpectedRuntime) {
-    let task = Task(task);
+    post_background_task(Task(task));
+}
+
+/// Runs the specified task in the background, or as virtual time prescribes.
+pub fn post_background_task(task: Task) {
+    if is_virtual_time() {
+        let mut state = VIRTUAL_CLOCK.lock().unwrap();
+
+        match state.background_tasks {
+            clock::BackgroundTasks::Inline => {
+                drop(state);
+                task.run();
+            }
+            clock::BackgroundTasks::Queued => state.queue.push_back(task),
+        }
+
+        return;
+    }
+
+    if let Some((node, cpus)) = affinity::background_node() {
+        let mut pools = NODE_POOLS.lock().unwrap();
+        let pool = pools.entry(node).or_insert_with(|| spawn_node_pool(node, cpus));
+        // The pool threads never exit, so the send can't fail
+        pool.send(task).unwrap();
+        return;
+    }
+
     thread::spawn(move || {
         unsafe {
             v8::v8_Task_Run(task.0);
@@ -110,6 +230,32 @@ extern "C" fn call_on_background_thread(task: v8::TaskPtr,
     });
 }
 
+fn spawn_node_pool(node: usize, cpus: Vec<usize>) -> mpsc::Sender<Task> {
+    let (sender, receiver) = mpsc::channel::<Task>();
+    let receiver = sync::Arc::new(sync::Mutex::new(receiver));
+
+    for _ in 0..cpus.len() {
+        let receiver = receiver.clone();
+        thread::Builder::new()
+            .name(format!("v8 node {} background", node))
+            .spawn(move || {
+                // An unpinned thread still runs the tasks, just without the locality
+                let _ = affinity::pin_to_node(node);
+
+                loop {
+                    let task = receiver.lock().unwrap().recv();
+                    match task {
+                        Ok(task) => task.run(),
+                        Err(_) => break,
+                    }
+                }
+            })
+            .unwrap();
+    }
+
+    sender
+}
+
 extern "C" fn call_on_foreground_thread(isolate: v8::IsolatePtr, task: v8::TaskPtr) {
     let task = Task(task);
     let isolate = unsafe { isolate::Isolate::from_raw(isolate) };
@@ -141,9 +287,7 @@ extern "C" fn idle_tasks_enabled(isolate: v8::IsolatePtr) -> bool {
 }
 
 extern "C" fn monotonically_increasing_time() -> f64 {
-    let start = *START_TIME;
-    let d = time::Instant::now().duration_since(start);
-    duration_to_seconds(d)
+    duration_to_seconds(now())
 }
 
 fn duration_to_seconds(duration: time::Duration) -> f64 {
@@ -153,3 +297,16 @@ fn duration_to_seconds(duration: time::Duration) -> f64 {
 fn duration_from_seconds(seconds: f64) -> time::Duration {
     time::Duration::new(seconds as u64, (seconds.fract() * 1e9) as u32)
 }
+
+extern "C" fn run_closure(data: *mut os::raw::c_void) {
+    // Unwinding into V8 is not an option, so a panicking task just ends early
+    let _ = panic::catch_unwind(panic::AssertUnwindSafe(|| unsafe {
+        (*(data as *mut Closure))();
+    }));
+}
+
+extern "C" fn destroy_closure(data: *mut os::raw::c_void) {
+    let _ = panic::catch_unwind(panic::AssertUnwindSafe(|| unsafe {
+        drop(Box::from_raw(data as *mut Closure));
+    }));
+}
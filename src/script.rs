@@ -66,6 +66,11 @@ impl Script {
             Ok(value::Value::from_raw(&self.0, raw))
         }
     }
+
+    /// Returns the underlying raw pointer behind this script.
+    pub fn as_raw(&self) -> v8::ScriptRef {
+        self.1
+    }
 }
 
 reference!(Script, v8::v8_Script_CloneRef, v8::v8_Script_DestroyRef);
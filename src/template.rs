@@ -5,11 +5,17 @@ use util;
 use value;
 use value::Data;
 use context;
+use weak;
+use std::cell;
+use std::cmp;
+use std::collections;
+use std::marker;
 use std::os;
 use std::ptr;
 use std::mem;
 use std::ops;
 use std::ffi;
+use std::rc;
 
 /// The superclass of object and function templates.
 #[derive(Debug)]
@@ -29,6 +35,56 @@ pub struct FunctionTemplate(isolate::Isolate, v8::FunctionTemplateRef);
 #[derive(Debug)]
 pub struct ObjectTemplate(isolate::Isolate, v8::ObjectTemplateRef);
 
+/// A template that is built at most once per isolate, and then shared by all of the contexts of
+/// the isolate; see `Isolate::template`.
+///
+/// V8 caches the function or object that it instantiates from a template per context, so reusing
+/// the same template is much cheaper than building a new one for every use.
+pub trait IsolateTemplate: 'static {
+    /// The kind of template that is built.
+    type Template: TemplateKind;
+
+    /// Builds the template.
+    fn build(isolate: &isolate::Isolate, context: &context::Context) -> Self::Template;
+}
+
+/// A kind of template that can be registered with an isolate; either `FunctionTemplate` or
+/// `ObjectTemplate`.
+pub trait TemplateKind: Sized {
+    /// Creates a template of this kind from a raw template pointer, which must point to a
+    /// template of this kind.
+    unsafe fn from_template_raw(isolate: &isolate::Isolate, raw: v8::TemplateRef) -> Self;
+
+    /// Returns the underlying raw pointer behind this template as a template pointer.
+    fn as_template_raw(&self) -> v8::TemplateRef;
+}
+
+/// A source of elements for array-like objects; see `ObjectTemplate::set_array_like`.
+pub trait ArraySource: 'static {
+    /// The number of elements.
+    fn len(&self) -> u32;
+
+    /// Produces the element at the specified index, which is less than `len()`.
+    fn get(&self, isolate: &isolate::Isolate, index: u32) -> value::ReturnValue;
+}
+
+/// A source of properties for map-like objects; see `ObjectTemplate::set_map_like`.
+pub trait MapSource: 'static {
+    /// Whether there is a property with the specified key.
+    fn contains_key(&self, key: &str) -> bool;
+
+    /// Produces the value of the property with the specified key, or `None` if there is no such
+    /// property.
+    fn get(&self,
+           isolate: &isolate::Isolate,
+           context: &context::Context,
+           key: &str)
+           -> Option<value::ReturnValue>;
+
+    /// The keys of all of the properties.
+    fn keys(&self) -> Vec<String>;
+}
+
 /// A Signature specifies which receiver is valid for a function.
 #[derive(Debug)]
 pub struct Signature(isolate::Isolate, v8::SignatureRef);
@@ -61,6 +117,27 @@ impl FunctionTemplate {
                context: &context::Context,
                callback: Box<value::FunctionCallback>)
                -> FunctionTemplate {
+        FunctionTemplate::new_inner(isolate, context, callback, ptr::null_mut())
+    }
+
+    /// Creates a function template whose functions may only be called with a receiver that is
+    /// accepted by the specified signature.
+    ///
+    /// Calling such a function with any other receiver throws a `TypeError` before the callback
+    /// is invoked.
+    pub fn new_with_signature(isolate: &isolate::Isolate,
+                              context: &context::Context,
+                              callback: Box<value::FunctionCallback>,
+                              signature: &Signature)
+                              -> FunctionTemplate {
+        FunctionTemplate::new_inner(isolate, context, callback, signature.1)
+    }
+
+    fn new_inner(isolate: &isolate::Isolate,
+                 context: &context::Context,
+                 callback: Box<value::FunctionCallback>,
+                 signature: v8::SignatureRef)
+                 -> FunctionTemplate {
         let raw = unsafe {
             let callback_ptr = Box::into_raw(Box::new(callback));
             let callback_ext = value::External::new::<Box<value::FunctionCallback>>(&isolate, callback_ptr);
@@ -76,7 +153,7 @@ impl FunctionTemplate {
                                              context.as_raw(),
                                              Some(util::callback),
                                              (&closure as &value::Value).as_raw(),
-                                             ptr::null_mut(),
+                                             signature,
                                              0,
                                              v8::ConstructorBehavior::ConstructorBehavior_kAllow)
                 })
@@ -85,6 +162,34 @@ impl FunctionTemplate {
         FunctionTemplate(isolate.clone(), raw)
     }
 
+    /// Returns the template that is used to create the `prototype` object of functions created
+    /// from this template.
+    pub fn prototype_template(&self) -> ObjectTemplate {
+        let raw = unsafe {
+            util::invoke(&self.0, |c| v8::v8_FunctionTemplate_PrototypeTemplate(c, self.1)).unwrap()
+        };
+        ObjectTemplate(self.0.clone(), raw)
+    }
+
+    /// Returns the template that is used to create objects when functions created from this
+    /// template are called as constructors.
+    pub fn instance_template(&self) -> ObjectTemplate {
+        let raw = unsafe {
+            util::invoke(&self.0, |c| v8::v8_FunctionTemplate_InstanceTemplate(c, self.1)).unwrap()
+        };
+        ObjectTemplate(self.0.clone(), raw)
+    }
+
+    /// Sets the name that is used for instances of this template, for example when printing them.
+    pub fn set_class_name(&self, name: &value::String) {
+        unsafe {
+            util::invoke(&self.0, |c| {
+                    v8::v8_FunctionTemplate_SetClassName(c, self.1, name.as_raw())
+                })
+                .unwrap()
+        };
+    }
+
     /// Returns the unique function instance in the current execution context.
     pub fn get_function(self, context: &context::Context) -> value::Function {
         unsafe {
@@ -95,6 +200,18 @@ impl FunctionTemplate {
             value::Function::from_raw(&self.0, raw)
         }
     }
+
+    /// Creates a function template from a set of raw pointers.
+    pub unsafe fn from_raw(isolate: &isolate::Isolate,
+                           raw: v8::FunctionTemplateRef)
+                           -> FunctionTemplate {
+        FunctionTemplate(isolate.clone(), raw)
+    }
+
+    /// Returns the underlying raw pointer behind this function template.
+    pub fn as_raw(&self) -> v8::FunctionTemplateRef {
+        self.1
+    }
 }
 
 impl ObjectTemplate {
@@ -133,6 +250,314 @@ impl ObjectTemplate {
         };
     }
 
+    /// Sets an accessor on the object template.
+    ///
+    /// Whenever the property with the specified name is accessed on objects created from this
+    /// template, the getter is called.  If a setter is specified, it is called when the property
+    /// is assigned; otherwise assignments are ignored.
+    pub fn set_accessor(&self,
+                        name: &str,
+                        getter: Box<value::AccessorGetterCallback>,
+                        setter: Option<Box<value::AccessorSetterCallback>>) {
+        let name = value::String::internalized_from_str(&self.0, name);
+        let has_setter = setter.is_some();
+        let data = util::accessor_data(&self.0, getter, setter);
+        unsafe {
+            util::invoke(&self.0, |c| {
+                    v8::v8_ObjectTemplate_SetAccessor_Name(c,
+                                                        self.1,
+                                                        name.as_raw() as v8::NameRef,
+                                                        Some(util::accessor_getter),
+                                                        if has_setter {
+                                                            Some(util::accessor_setter)
+                                                        } else {
+                                                            None
+                                                        },
+                                                        data.as_raw() as v8::ValueRef,
+                                                        v8::AccessControl::AccessControl_DEFAULT,
+                                                        v8::PropertyAttribute::PropertyAttribute_None,
+                                                        ptr::null_mut())
+                })
+                .unwrap()
+        };
+    }
+
+    /// Sets a native data property on the object template.
+    ///
+    /// This is like `set_accessor`, but the property behaves like a plain data property from the
+    /// point of view of Javascript: it is not installed on the prototype chain as an accessor and
+    /// does not trigger interceptors.
+    pub fn set_native_data_property(&self,
+                                    name: &str,
+                                    getter: Box<value::AccessorGetterCallback>,
+                                    setter: Option<Box<value::AccessorSetterCallback>>) {
+        self.set_native_data_property_inner(name,
+                                            getter,
+                                            setter,
+                                            v8::PropertyAttribute::PropertyAttribute_None);
+    }
+
+    fn set_native_data_property_inner(&self,
+                                      name: &str,
+                                      getter: Box<value::AccessorGetterCallback>,
+                                      setter: Option<Box<value::AccessorSetterCallback>>,
+                                      attribute: v8::PropertyAttribute) {
+        let name = value::String::internalized_from_str(&self.0, name);
+        let has_setter = setter.is_some();
+        let data = util::accessor_data(&self.0, getter, setter);
+        let template: &Template = self;
+        unsafe {
+            util::invoke(&self.0, |c| {
+                    v8::v8_Template_SetNativeDataProperty_Name(c,
+                                                            template.1,
+                                                            name.as_raw() as v8::NameRef,
+                                                            Some(util::accessor_getter),
+                                                            if has_setter {
+                                                                Some(util::accessor_setter)
+                                                            } else {
+                                                                None
+                                                            },
+                                                            data.as_raw() as v8::ValueRef,
+                                                            attribute,
+                                                            ptr::null_mut(),
+                                                            v8::AccessControl::AccessControl_DEFAULT)
+                })
+                .unwrap()
+        };
+    }
+
+    /// Sets a lazy data property on the object template.
+    ///
+    /// The initializer runs the first time the property is read on an object created from this
+    /// template, and the value it returns then replaces the property as an ordinary data property
+    /// of that object.  Assigning to the property before reading it skips the initializer.  Pass
+    /// the template to `Context::new_with_global_template` to offer lazy globals in every context.
+    pub fn set_lazy_data_property(&self, name: &str, initializer: Box<value::LazyDataInitializer>) {
+        let accessor = util::lazy_data_accessor(initializer);
+        self.set_native_data_property(name, accessor.getter, accessor.setter);
+    }
+
+    /// Sets an indexed property handler on the object template.
+    ///
+    /// Whenever an indexed property is accessed on objects created from this template, the
+    /// corresponding callback of the handler is called and may intercept the access.
+    pub fn set_indexed_handler(&self, handler: value::IndexedPropertyHandler) {
+        let has_setter = handler.setter.is_some();
+        let has_query = handler.query.is_some();
+        let has_enumerator = handler.enumerator.is_some();
+
+        let data = value::External::new_owned(&self.0, Box::new(handler));
+
+        let configuration = v8::IndexedPropertyHandlerConfiguration {
+            getter: Some(util::indexed_property_getter),
+            setter: if has_setter {
+                Some(util::indexed_property_setter)
+            } else {
+                None
+            },
+            query: if has_query {
+                Some(util::indexed_property_query)
+            } else {
+                None
+            },
+            deleter: None,
+            enumerator: if has_enumerator {
+                Some(util::indexed_property_enumerator)
+            } else {
+                None
+            },
+            data: data.as_raw() as v8::ValueRef,
+            flags: v8::PropertyHandlerFlags::PropertyHandlerFlags_kNone,
+        };
+
+        unsafe {
+            util::invoke(&self.0,
+                         |c| v8::v8_ObjectTemplate_SetHandler(c, self.1, configuration))
+                .unwrap()
+        };
+    }
+
+    /// Makes objects created from this template behave like read-only arrays, whose elements are
+    /// produced on demand by the specified source.
+    ///
+    /// The elements are never copied into the Javascript heap, so this is suitable for exposing
+    /// large amounts of data of which Javascript only reads a small part.  The objects also get a
+    /// `length` property, and can be passed to generic array methods such as
+    /// `Array.prototype.map.call`.
+    pub fn set_array_like<S>(&self, source: S)
+        where S: ArraySource
+    {
+        let source = rc::Rc::new(source);
+        let getter_source = source.clone();
+        let setter_source = source.clone();
+        let query_source = source.clone();
+        let enumerator_source = source.clone();
+
+        self.set_indexed_handler(value::IndexedPropertyHandler {
+            getter: Box::new(move |index, info| if index < getter_source.len() {
+                Ok(Some(getter_source.get(&info.isolate, index)))
+            } else {
+                Ok(None)
+            }),
+            // Swallow writes to elements, like a frozen array in sloppy mode would
+            setter: Some(Box::new(move |index, _, _| Ok(index < setter_source.len()))),
+            query: Some(Box::new(move |index, _| if index < query_source.len() {
+                Ok(Some(value::PropertyAttributes {
+                    read_only: true,
+                    dont_enum: false,
+                    dont_delete: true,
+                }))
+            } else {
+                Ok(None)
+            }),
+            enumerator: Some(Box::new(move |info| {
+                let context = info.isolate.current_context().unwrap();
+                let length = enumerator_source.len();
+                let keys = value::Array::new(&info.isolate, &context, length);
+                for index in 0..length {
+                    let key = value::Integer::new_from_unsigned(&info.isolate, index);
+                    keys.set_index(&context, index, &key);
+                }
+                Ok(keys)
+            })),
+        });
+
+        self.set_native_data_property_inner("length",
+                                            Box::new(move |_, _| {
+                                                Ok(value::ReturnValue::Uint32(source.len()))
+                                            }),
+                                            None,
+                                            v8::PropertyAttribute::PropertyAttribute_DontEnum);
+    }
+
+    /// Sets a named property handler on the object template.
+    ///
+    /// Whenever a named property is accessed on objects created from this template, the
+    /// corresponding callback of the handler is called and may intercept the access.
+    pub fn set_named_handler(&self, handler: value::NamedPropertyHandler) {
+        let has_setter = handler.setter.is_some();
+        let has_query = handler.query.is_some();
+        let has_deleter = handler.deleter.is_some();
+        let has_enumerator = handler.enumerator.is_some();
+
+        let data = value::External::new_owned(&self.0, Box::new(handler));
+
+        let configuration = v8::NamedPropertyHandlerConfiguration {
+            getter: Some(util::named_property_getter),
+            setter: if has_setter {
+                Some(util::named_property_setter)
+            } else {
+                None
+            },
+            query: if has_query {
+                Some(util::named_property_query)
+            } else {
+                None
+            },
+            deleter: if has_deleter {
+                Some(util::named_property_deleter)
+            } else {
+                None
+            },
+            enumerator: if has_enumerator {
+                Some(util::named_property_enumerator)
+            } else {
+                None
+            },
+            data: data.as_raw() as v8::ValueRef,
+            flags: v8::PropertyHandlerFlags::PropertyHandlerFlags_kOnlyInterceptStrings,
+        };
+
+        unsafe {
+            util::invoke(&self.0,
+                         |c| v8::v8_ObjectTemplate_SetHandler_Name(c, self.1, configuration))
+                .unwrap()
+        };
+    }
+
+    /// Makes objects created from this template expose the properties of the specified source as
+    /// read-only properties.
+    ///
+    /// Property values are only converted into Javascript values when a script accesses them, so
+    /// large maps (or trees of maps) can be handed to scripts that only look at a few properties.
+    /// Properties with keys that are not in the source can still be added to the objects as usual.
+    pub fn set_map_like<S>(&self, source: S)
+        where S: MapSource
+    {
+        let source = rc::Rc::new(source);
+        self.set_map_handler(move |_| Some(source.clone()));
+    }
+
+    /// Sets a named handler that exposes the map source that `lookup` returns for the holder of
+    /// each property access.
+    fn set_map_handler<S, F>(&self, lookup: F)
+        where S: MapSource,
+              F: Fn(&value::Object) -> Option<rc::Rc<S>> + 'static
+    {
+        let lookup = rc::Rc::new(lookup);
+        let getter_lookup = lookup.clone();
+        let setter_lookup = lookup.clone();
+        let query_lookup = lookup.clone();
+        let deleter_lookup = lookup.clone();
+        let enumerator_lookup = lookup.clone();
+
+        self.set_named_handler(value::NamedPropertyHandler {
+            getter: Box::new(move |property, info| {
+                let (key, source) = match (property_key(property), getter_lookup(&info.holder)) {
+                    (Some(key), Some(source)) => (key, source),
+                    _ => return Ok(None),
+                };
+                let context = info.isolate.current_context().unwrap();
+                Ok(source.get(&info.isolate, &context, &key))
+            }),
+            // Swallow writes to source properties, like a frozen object in sloppy mode would
+            setter: Some(Box::new(move |property, _, info| {
+                match (property_key(property), setter_lookup(&info.holder)) {
+                    (Some(key), Some(source)) => Ok(source.contains_key(&key)),
+                    _ => Ok(false),
+                }
+            })),
+            query: Some(Box::new(move |property, info| {
+                let (key, source) = match (property_key(property), query_lookup(&info.holder)) {
+                    (Some(key), Some(source)) => (key, source),
+                    _ => return Ok(None),
+                };
+                if source.contains_key(&key) {
+                    Ok(Some(value::PropertyAttributes {
+                        read_only: true,
+                        dont_enum: false,
+                        dont_delete: true,
+                    }))
+                } else {
+                    Ok(None)
+                }
+            })),
+            deleter: Some(Box::new(move |property, info| {
+                let (key, source) = match (property_key(property), deleter_lookup(&info.holder)) {
+                    (Some(key), Some(source)) => (key, source),
+                    _ => return Ok(None),
+                };
+                if source.contains_key(&key) {
+                    Ok(Some(false))
+                } else {
+                    Ok(None)
+                }
+            })),
+            enumerator: Some(Box::new(move |info| {
+                let context = info.isolate.current_context().unwrap();
+                let keys = enumerator_lookup(&info.holder)
+                    .map(|source| source.keys())
+                    .unwrap_or_else(Vec::new);
+                let array = value::Array::new(&info.isolate, &context, keys.len() as u32);
+                for (index, key) in keys.iter().enumerate() {
+                    let key = value::String::from_str(&info.isolate, key);
+                    array.set_index(&context, index as u32, &key);
+                }
+                Ok(array)
+            })),
+        });
+    }
+
     /// Creates a new object instance based off of this template.
     pub fn new_instance(&self, context: &context::Context) -> value::Object {
         unsafe {
@@ -157,6 +582,172 @@ impl ObjectTemplate {
     }
 }
 
+/// Javascript array indices are 32-bit, so only the first `u32::MAX` elements are visible.
+impl<T> ArraySource for Vec<T>
+    where T: Copy + Into<value::ReturnValue> + 'static
+{
+    fn len(&self) -> u32 {
+        cmp::min(Vec::len(self), u32::max_value() as usize) as u32
+    }
+
+    fn get(&self, _: &isolate::Isolate, index: u32) -> value::ReturnValue {
+        self[index as usize].into()
+    }
+}
+
+impl<V> MapSource for collections::HashMap<String, V>
+    where V: value::ToValue + 'static
+{
+    fn contains_key(&self, key: &str) -> bool {
+        collections::HashMap::contains_key(self, key)
+    }
+
+    fn get(&self,
+           isolate: &isolate::Isolate,
+           context: &context::Context,
+           key: &str)
+           -> Option<value::ReturnValue> {
+        collections::HashMap::get(self, key).map(|v| v.to_value(isolate, context))
+    }
+
+    fn keys(&self) -> Vec<String> {
+        collections::HashMap::keys(self).cloned().collect()
+    }
+}
+
+impl<S> MapSource for rc::Rc<S>
+    where S: MapSource
+{
+    fn contains_key(&self, key: &str) -> bool {
+        (**self).contains_key(key)
+    }
+
+    fn get(&self,
+           isolate: &isolate::Isolate,
+           context: &context::Context,
+           key: &str)
+           -> Option<value::ReturnValue> {
+        (**self).get(isolate, context, key)
+    }
+
+    fn keys(&self) -> Vec<String> {
+        (**self).keys()
+    }
+}
+
+/// Shared maps convert into lazy objects themselves, so that a tree of maps is only converted as
+/// far as a script traverses it.
+///
+/// Every conversion of the same map in the same context returns the same object, as long as that
+/// object is alive.  The objects of all maps with values of type `V` share one template, which is
+/// registered with the isolate.
+impl<V> value::ToValue for rc::Rc<collections::HashMap<String, V>>
+    where V: value::ToValue + 'static
+{
+    fn to_value(&self,
+                isolate: &isolate::Isolate,
+                context: &context::Context)
+                -> value::ReturnValue {
+        let objects = match context.slot::<SharedMapObjects>() {
+            Some(objects) => objects,
+            None => {
+                context.set_slot(SharedMapObjects(cell::RefCell::new(collections::HashMap::new())));
+                context.slot::<SharedMapObjects>().unwrap()
+            }
+        };
+
+        // The object owns a clone of the map, so the address can't be reused while it is alive
+        let key = &**self as *const collections::HashMap<String, V> as usize;
+
+        if let Some(object) = objects.0.borrow().get(&key).and_then(|w| w.upgrade()) {
+            return value::ReturnValue::Value(object.into());
+        }
+
+        let object = isolate.template::<SharedMapTemplate<V>>(context).new_instance(context);
+
+        unsafe {
+            let map = Box::into_raw(Box::new(self.clone()));
+            object.set_aligned_pointer_in_internal_field(SHARED_MAP_FIELD, map);
+            util::invoke(isolate, |c| {
+                    v8::v8_Value_SetWeakFinalizer(c,
+                                                  object.as_raw() as v8::ValueRef,
+                                                  Some(util::drop_in_finalizer::<SharedMap<V>>),
+                                                  map as *mut os::raw::c_void,
+                                                  0)
+                })
+                .unwrap();
+        }
+
+        // Forget the entry once the object is gone, unless a newer object has taken its place
+        let finalizer_objects = rc::Rc::downgrade(&objects);
+        let entry = weak::Weak::with_finalizer(isolate, &object, move || {
+            if let Some(objects) = finalizer_objects.upgrade() {
+                let mut objects = objects.0.borrow_mut();
+                if objects.get(&key).map_or(false, |w| w.is_empty()) {
+                    objects.remove(&key);
+                }
+            }
+        });
+        objects.0.borrow_mut().insert(key, entry);
+
+        value::ReturnValue::Value(object.into())
+    }
+}
+
+/// A map that is shared between Rust and the lazy objects it converts into.
+type SharedMap<V> = rc::Rc<collections::HashMap<String, V>>;
+
+/// The internal field of a shared map object that holds the pointer to its map.
+const SHARED_MAP_FIELD: u32 = 0;
+
+/// The template of the objects that shared maps with values of type `V` convert into.
+struct SharedMapTemplate<V>(marker::PhantomData<V>);
+
+/// The objects that shared maps have been converted into in a context, by the address of the map.
+struct SharedMapObjects(cell::RefCell<collections::HashMap<usize, weak::Weak<value::Object>>>);
+
+impl<V> IsolateTemplate for SharedMapTemplate<V>
+    where V: value::ToValue + 'static
+{
+    type Template = ObjectTemplate;
+
+    fn build(isolate: &isolate::Isolate, _: &context::Context) -> ObjectTemplate {
+        let template = ObjectTemplate::new(isolate);
+        template.set_internal_field_count(SHARED_MAP_FIELD as usize + 1);
+        template.set_map_handler(|holder| unsafe {
+            holder.get_aligned_pointer_from_internal_field::<SharedMap<V>>(SHARED_MAP_FIELD)
+                .as_ref()
+                .cloned()
+        });
+        template
+    }
+}
+
+impl TemplateKind for FunctionTemplate {
+    unsafe fn from_template_raw(isolate: &isolate::Isolate, raw: v8::TemplateRef) -> Self {
+        FunctionTemplate(isolate.clone(), raw as v8::FunctionTemplateRef)
+    }
+
+    fn as_template_raw(&self) -> v8::TemplateRef {
+        self.1 as v8::TemplateRef
+    }
+}
+
+impl TemplateKind for ObjectTemplate {
+    unsafe fn from_template_raw(isolate: &isolate::Isolate, raw: v8::TemplateRef) -> Self {
+        ObjectTemplate(isolate.clone(), raw as v8::ObjectTemplateRef)
+    }
+
+    fn as_template_raw(&self) -> v8::TemplateRef {
+        self.1 as v8::TemplateRef
+    }
+}
+
+fn property_key(property: value::Name) -> Option<String> {
+    let property: value::Value = property.into();
+    property.into_string().map(|s| s.value())
+}
+
 inherit!(Template, Data);
 inherit!(ObjectTemplate, Template);
 inherit!(FunctionTemplate, Template);
@@ -4,10 +4,62 @@ use error;
 use isolate;
 use std::any;
 use std::mem;
+use std::os;
 use std::panic;
 use std::ptr;
 use value;
 
+/// How small integers (Smis) are tagged in the build of V8 that the glue was compiled against.
+struct SmiLayout {
+    tag: isize,
+    tag_mask: isize,
+    shift: u32,
+}
+
+lazy_static! {
+    static ref SMI_LAYOUT: SmiLayout = {
+        let (mut tag, mut tag_size, mut shift_size) = (0, 0, 0);
+        unsafe { v8::v8_Smi_Layout(&mut tag, &mut tag_size, &mut shift_size) };
+
+        SmiLayout {
+            tag: tag as isize,
+            tag_mask: (1isize << tag_size) - 1,
+            shift: (tag_size + shift_size) as u32,
+        }
+    };
+}
+
+/// Reads a value directly out of its handle if it is a small integer (Smi), without calling into
+/// V8 at all.
+///
+/// The Smi encoding depends on how V8 was built, so it is decoded as described by the glue.
+pub unsafe fn smi_value(raw: v8::ValueRef) -> Option<i32> {
+    // A persistent handle points at a global handle slot, which holds the tagged word
+    let slot = *(raw as *const *const isize);
+    if slot.is_null() {
+        return None;
+    }
+
+    let word = *slot;
+    let layout = &*SMI_LAYOUT;
+
+    if word & layout.tag_mask == layout.tag {
+        Some((word >> layout.shift) as i32)
+    } else {
+        None
+    }
+}
+
+/// A weak finalizer that drops the boxed value that its parameter points to.
+///
+/// Unwinding into the garbage collector is not an option, so a panicking destructor only leaks
+/// whatever it did not get to clean up.
+pub extern "C" fn drop_in_finalizer<T>(parameter: *mut os::raw::c_void) {
+    let _ = panic::catch_unwind(panic::AssertUnwindSafe(|| unsafe {
+        drop(Box::from_raw(parameter as *mut T));
+    }));
+}
+
 pub fn invoke<F, B>(isolate: &isolate::Isolate, func: F) -> error::Result<B>
     where F: FnOnce(v8::RustContext) -> B
 {
@@ -31,13 +83,20 @@ fn invoke_inner<F, B>(isolate: &isolate::Isolate,
 {
     let mut exception = ptr::null_mut();
     let mut message = ptr::null_mut();
+    let entered_context = isolate.entered_context_raw();
     let rust_ctx = v8::RustContext {
         isolate: isolate.as_raw(),
         exception: &mut exception,
         message: &mut message,
+        isolate_entered: !entered_context.is_null(),
+        // Every handle owns its own persistent, so this only recognizes the very handle that was
+        // entered; other handles to the same context merely enter it again.
+        context_entered: context.map_or(false, |c| c.as_raw() == entered_context),
     };
 
+    isolate.begin_glue_call();
     let result = func(rust_ctx);
+    isolate.end_glue_call();
 
     if exception.is_null() {
         assert!(message.is_null());
@@ -46,33 +105,71 @@ fn invoke_inner<F, B>(isolate: &isolate::Isolate,
         assert!(!message.is_null());
         let exception = unsafe { value::Value::from_raw(isolate, exception) };
         let message = unsafe { error::Message::from_raw(isolate, message) };
-        let context = context.map(|c| c.clone())
-            .or_else(|| isolate.current_context())
-            .unwrap_or_else(|| context::Context::new(&isolate));
-
-        if exception.is_object() {
-            let exception = exception.into_object().unwrap();
-            let panic_info_key = value::String::from_str(isolate, "panicInfo");
-
-            if exception.has(&context, &panic_info_key) {
-                match exception.get(&context, &panic_info_key).into_external() {
-                    Some(panic_info) => {
-                        let panic_info =
-                            unsafe {
-                                Box::from_raw(panic_info.value() as *mut Box<any::Any + Send + 'static>)
-                            };
-                        panic::resume_unwind(panic_info);
-                    }
-                    None => {
-                        // Somebody is playing tricks on us, creating random panicInfo properties...
-                    }
-                }
-            }
+
+        if let Some(panic_info) = take_panic_info(isolate, context, &exception) {
+            panic::resume_unwind(panic_info);
         }
 
-        let message_str = message.get(&context).value();
-        let stack_trace = message.get_stack_trace().to_captured();
-        Err(error::ErrorKind::Javascript(message_str, stack_trace).into())
+        let exception = error::JavascriptException::new(exception, message);
+        Err(error::ErrorKind::Javascript(exception).into())
+    }
+}
+
+/// Resumes unwinding if the exception was created from a Rust panic by `create_panic_error`.
+///
+/// Used for exceptions that are caught without going through `invoke`.
+pub fn resume_panic(isolate: &isolate::Isolate,
+                    context: &context::Context,
+                    exception: &value::Value) {
+    if let Some(panic_info) = take_panic_info(isolate, Some(context), exception) {
+        panic::resume_unwind(panic_info);
+    }
+}
+
+/// Extracts the Rust panic payload from an exception created by `create_panic_error`, if there is
+/// one.
+///
+/// The payload is stored under a private symbol, so scripts cannot forge or observe it, and the
+/// lookup does not need to allocate a property key string.  Panics are always thrown as error
+/// objects, so without a context from the caller the lookup happens in the context the exception
+/// was created in, and nothing is resolved for other exceptions.
+fn take_panic_info(isolate: &isolate::Isolate,
+                   context: Option<&context::Context>,
+                   exception: &value::Value)
+                   -> Option<Box<any::Any + Send + 'static>> {
+    if !exception.is_object() {
+        return None;
+    }
+
+    let key = isolate.panic_info_key_raw();
+    let object = exception.as_raw() as v8::ObjectRef;
+    let creation_context;
+    let context = match context {
+        Some(context) => context,
+        None => {
+            creation_context = unsafe {
+                let raw = invoke(isolate, |c| v8::v8_Object_CreationContext(c, object)).unwrap();
+                context::Context::from_raw(isolate, raw)
+            };
+            &creation_context
+        }
+    };
+
+    unsafe {
+        let panic_info = invoke_ctx(isolate, context, |c| {
+                v8::v8_Object_GetPrivate(c, object, context.as_raw(), key)
+            })
+            .map(|raw| value::Value::from_raw(isolate, raw))
+            .ok()
+            .and_then(|v| v.into_external());
+
+        panic_info.map(|panic_info| {
+            // Make sure that the payload can't be taken twice if the exception is re-thrown.
+            let _ = invoke_ctx(isolate, context, |c| {
+                v8::v8_Object_DeletePrivate(c, object, context.as_raw(), key)
+            });
+            *Box::from_raw(panic_info.value::<Box<any::Any + Send + 'static>>())
+        })
     }
 }
 
@@ -118,6 +215,280 @@ pub extern "C" fn callback(callback_info: v8::FunctionCallbackInfoPtr_Value) {
     }
 }
 
+/// The closures behind a native accessor, stored in an `External` as the accessor data.
+pub struct Accessor {
+    pub getter: Box<value::AccessorGetterCallback>,
+    pub setter: Option<Box<value::AccessorSetterCallback>>,
+}
+
+/// Stores the closures of an accessor in an `External`, to be used as the accessor data.
+///
+/// The closures are dropped when the external is garbage collected, which happens once the
+/// accessor has been removed or replaced, or the template it was set on is gone.
+pub fn accessor_data(isolate: &isolate::Isolate,
+                     getter: Box<value::AccessorGetterCallback>,
+                     setter: Option<Box<value::AccessorSetterCallback>>)
+                     -> value::External {
+    let accessor = Accessor {
+        getter: getter,
+        setter: setter,
+    };
+    value::External::new_owned(isolate, Box::new(accessor))
+}
+
+/// Creates an accessor that replaces itself with a data property holding the value of the
+/// initializer on first read, or the assigned value on first write.
+pub fn lazy_data_accessor(initializer: Box<value::LazyDataInitializer>) -> Accessor {
+    let getter = move |name: value::Name, info: value::PropertyCallbackInfo| {
+        let context = info.isolate.current_context().unwrap();
+        let holder = info.holder.clone();
+        let value = try!(initializer(info));
+        holder.create_data_property(&context, &name, &value);
+        Ok(value::ReturnValue::Value(value))
+    };
+
+    let setter = |name: value::Name, value: value::Value, info: value::PropertyCallbackInfo| {
+        let context = info.isolate.current_context().unwrap();
+        info.holder.create_data_property(&context, &name, &value);
+        Ok(())
+    };
+
+    Accessor {
+        getter: Box::new(getter),
+        setter: Some(Box::new(setter)),
+    }
+}
+
+pub extern "C" fn accessor_getter(property: v8::NameRef,
+                                  callback_info: v8::PropertyCallbackInfoPtr_Value) {
+    unsafe {
+        handle_property_callback(callback_info, |isolate, accessor: &Accessor, info| {
+            let property = value::Name::from_raw(isolate, property);
+            (accessor.getter)(property, info).map(Some)
+        })
+    }
+}
+
+pub extern "C" fn accessor_setter(property: v8::NameRef,
+                                  value: v8::ValueRef,
+                                  callback_info: v8::PropertyCallbackInfoPtr_Void) {
+    unsafe {
+        handle_property_callback(callback_info, |isolate, accessor: &Accessor, info| {
+            let property = value::Name::from_raw(isolate, property);
+            let value = value::Value::from_raw(isolate, value);
+            match accessor.setter {
+                Some(ref setter) => setter(property, value, info).map(|()| None),
+                None => Ok(None),
+            }
+        })
+    }
+}
+
+pub extern "C" fn indexed_property_getter(index: u32,
+                                          callback_info: v8::PropertyCallbackInfoPtr_Value) {
+    unsafe {
+        handle_property_callback(callback_info,
+                                 |_, handler: &value::IndexedPropertyHandler, info| {
+                                     (handler.getter)(index, info)
+                                 })
+    }
+}
+
+pub extern "C" fn indexed_property_setter(index: u32,
+                                          value: v8::ValueRef,
+                                          callback_info: v8::PropertyCallbackInfoPtr_Value) {
+    unsafe {
+        handle_property_callback(callback_info,
+                                 |isolate, handler: &value::IndexedPropertyHandler, info| {
+            let value = value::Value::from_raw(isolate, value);
+            match handler.setter {
+                Some(ref setter) => {
+                    setter(index, value, info)
+                        .map(|intercepted| if intercepted {
+                            Some(value::ReturnValue::Boolean(true))
+                        } else {
+                            None
+                        })
+                }
+                None => Ok(None),
+            }
+        })
+    }
+}
+
+pub extern "C" fn indexed_property_query(index: u32,
+                                         callback_info: v8::PropertyCallbackInfoPtr_Integer) {
+    unsafe {
+        handle_property_callback(callback_info,
+                                 |_, handler: &value::IndexedPropertyHandler, info| {
+            match handler.query {
+                Some(ref query) => {
+                    query(index, info)
+                        .map(|attributes| attributes.map(|a| value::ReturnValue::Int32(a.bits())))
+                }
+                None => Ok(None),
+            }
+        })
+    }
+}
+
+pub extern "C" fn indexed_property_enumerator(callback_info: v8::PropertyCallbackInfoPtr_Array) {
+    unsafe {
+        handle_property_callback(callback_info,
+                                 |_, handler: &value::IndexedPropertyHandler, info| {
+            match handler.enumerator {
+                Some(ref enumerator) => {
+                    enumerator(info).map(|keys| Some(value::ReturnValue::Value(keys.into())))
+                }
+                None => Ok(None),
+            }
+        })
+    }
+}
+
+pub extern "C" fn named_property_getter(property: v8::NameRef,
+                                        callback_info: v8::PropertyCallbackInfoPtr_Value) {
+    unsafe {
+        handle_property_callback(callback_info,
+                                 |isolate, handler: &value::NamedPropertyHandler, info| {
+            let property = value::Name::from_raw(isolate, property);
+            (handler.getter)(property, info)
+        })
+    }
+}
+
+pub extern "C" fn named_property_setter(property: v8::NameRef,
+                                        value: v8::ValueRef,
+                                        callback_info: v8::PropertyCallbackInfoPtr_Value) {
+    unsafe {
+        handle_property_callback(callback_info,
+                                 |isolate, handler: &value::NamedPropertyHandler, info| {
+            let property = value::Name::from_raw(isolate, property);
+            let value = value::Value::from_raw(isolate, value);
+            match handler.setter {
+                Some(ref setter) => {
+                    setter(property, value, info)
+                        .map(|intercepted| if intercepted {
+                            Some(value::ReturnValue::Boolean(true))
+                        } else {
+                            None
+                        })
+                }
+                None => Ok(None),
+            }
+        })
+    }
+}
+
+pub extern "C" fn named_property_query(property: v8::NameRef,
+                                       callback_info: v8::PropertyCallbackInfoPtr_Integer) {
+    unsafe {
+        handle_property_callback(callback_info,
+                                 |isolate, handler: &value::NamedPropertyHandler, info| {
+            let property = value::Name::from_raw(isolate, property);
+            match handler.query {
+                Some(ref query) => {
+                    query(property, info)
+                        .map(|attributes| attributes.map(|a| value::ReturnValue::Int32(a.bits())))
+                }
+                None => Ok(None),
+            }
+        })
+    }
+}
+
+pub extern "C" fn named_property_deleter(property: v8::NameRef,
+                                         callback_info: v8::PropertyCallbackInfoPtr_Boolean) {
+    unsafe {
+        handle_property_callback(callback_info,
+                                 |isolate, handler: &value::NamedPropertyHandler, info| {
+            let property = value::Name::from_raw(isolate, property);
+            match handler.deleter {
+                Some(ref deleter) => {
+                    deleter(property, info).map(|deleted| deleted.map(value::ReturnValue::Boolean))
+                }
+                None => Ok(None),
+            }
+        })
+    }
+}
+
+pub extern "C" fn named_property_enumerator(callback_info: v8::PropertyCallbackInfoPtr_Array) {
+    unsafe {
+        handle_property_callback(callback_info,
+                                 |_, handler: &value::NamedPropertyHandler, info| {
+            match handler.enumerator {
+                Some(ref enumerator) => {
+                    enumerator(info).map(|keys| Some(value::ReturnValue::Value(keys.into())))
+                }
+                None => Ok(None),
+            }
+        })
+    }
+}
+
+/// Runs a property callback whose closures of type `H` are stored in an `External` as the
+/// callback data, and hands its result or exception back to V8.
+unsafe fn handle_property_callback<H, F>(callback_info: *mut v8::PropertyCallbackInfo, func: F)
+    where F: FnOnce(&isolate::Isolate, &H, value::PropertyCallbackInfo)
+                    -> Result<Option<value::ReturnValue>, value::Value>
+{
+    let callback_info = callback_info.as_mut().unwrap();
+    let isolate = isolate::Isolate::from_raw(callback_info.GetIsolate);
+    let data = value::External::from_raw(&isolate, callback_info.Data as v8::ExternalRef);
+    let info = property_callback_info(&isolate, callback_info);
+
+    let result = panic::catch_unwind(panic::AssertUnwindSafe(|| {
+        let handler: *mut H = data.value();
+        func(&isolate, handler.as_ref().unwrap(), info)
+    }));
+
+    match result {
+        Ok(Ok(Some(value))) => set_return_value(callback_info, value),
+        Ok(Ok(None)) => {}
+        Ok(Err(exception)) => {
+            throw_exception(&isolate, &exception);
+        }
+        Err(panic) => {
+            let error = create_panic_error(&isolate, panic);
+            callback_info.ThrownValue = error.into_raw();
+        }
+    }
+}
+
+unsafe fn property_callback_info(isolate: &isolate::Isolate,
+                                 callback_info: &v8::PropertyCallbackInfo)
+                                 -> value::PropertyCallbackInfo {
+    value::PropertyCallbackInfo {
+        isolate: isolate.clone(),
+        this: value::Object::from_raw(isolate, callback_info.This),
+        holder: value::Object::from_raw(isolate, callback_info.Holder),
+        should_throw_on_error: callback_info.ShouldThrowOnError,
+    }
+}
+
+/// Stores a property callback result in the callback info, using the primitive return slot where
+/// possible so that no handle needs to be allocated.
+fn set_return_value(callback_info: &mut v8::PropertyCallbackInfo, value: value::ReturnValue) {
+    use v8_sys::PrimitiveReturnValue::*;
+
+    let (primitive, number) = match value {
+        value::ReturnValue::Undefined => (PrimitiveReturnValue_Undefined, 0.0),
+        value::ReturnValue::Null => (PrimitiveReturnValue_Null, 0.0),
+        value::ReturnValue::Boolean(b) => (PrimitiveReturnValue_Boolean, if b { 1.0 } else { 0.0 }),
+        value::ReturnValue::Int32(i) => (PrimitiveReturnValue_Int32, i as f64),
+        value::ReturnValue::Uint32(u) => (PrimitiveReturnValue_Uint32, u as f64),
+        value::ReturnValue::Number(n) => (PrimitiveReturnValue_Number, n),
+        value::ReturnValue::Value(v) => {
+            callback_info.ReturnValue = v.into_raw();
+            return;
+        }
+    };
+
+    callback_info.ReturnPrimitive = primitive;
+    callback_info.ReturnNumber = number;
+}
+
 fn throw_exception(isolate: &isolate::Isolate, exception: &value::Value) -> value::Value {
     unsafe {
         let raw = v8::v8_Isolate_ThrowException(isolate.as_raw(), exception.as_raw()).as_mut().unwrap();
@@ -138,9 +509,9 @@ fn create_panic_error(isolate: &isolate::Isolate,
 
     let exception = value::Exception::error(&isolate, &message).into_object().unwrap();
 
-    let panic_info_key = value::String::from_str(isolate, "panicInfo");
+    let panic_info_key = isolate.panic_info_key();
     let panic_info = unsafe { value::External::new(&isolate, Box::into_raw(Box::new(panic))) };
-    exception.set(&context, &panic_info_key, &panic_info);
+    exception.set_private(&context, &panic_info_key, &panic_info);
 
     exception.into()
 }
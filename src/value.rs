@@ -3,11 +3,13 @@ use v8_sys as v8;
 use context;
 use error;
 use isolate;
+use iter;
 use util;
 use std::mem;
 use std::ops;
 use std::os;
 use std::ptr;
+use std::slice;
 use template;
 
 /// The superclass of values and API object templates.
@@ -177,6 +179,12 @@ pub struct DataView(isolate::Isolate, v8::DataViewRef);
 #[derive(Debug)]
 pub struct SharedArrayBuffer(isolate::Isolate, v8::SharedArrayBufferRef);
 
+/// A compiled WebAssembly module, as created by the built-in `WebAssembly.Module` constructor.
+///
+/// This API is experimental and may change significantly.
+#[derive(Debug)]
+pub struct WasmCompiledModule(isolate::Isolate, v8::WasmCompiledModuleRef);
+
 /// An instance of the built-in Date constructor (ECMA-262, 15.9).
 #[derive(Debug)]
 pub struct Date(isolate::Isolate, v8::DateRef);
@@ -211,8 +219,10 @@ pub struct External(isolate::Isolate, v8::ExternalRef);
 pub struct Exception(isolate::Isolate, v8::ExceptionRef);
 
 pub struct PropertyCallbackInfo {
+    pub isolate: isolate::Isolate,
     pub this: Object,
     pub holder: Object,
+    pub should_throw_on_error: bool,
 }
 
 pub struct FunctionCallbackInfo {
@@ -227,6 +237,118 @@ pub struct FunctionCallbackInfo {
 
 pub type FunctionCallback = Fn(FunctionCallbackInfo) -> Result<Value, Value> + 'static;
 
+/// The getter of a native accessor.  Gets called with the name of the accessed property.
+pub type AccessorGetterCallback = Fn(Name, PropertyCallbackInfo) -> Result<ReturnValue, Value> +
+                                  'static;
+
+/// The setter of a native accessor.  Gets called with the name of the accessed property and the
+/// value that is being assigned.
+pub type AccessorSetterCallback = Fn(Name, Value, PropertyCallbackInfo) -> Result<(), Value> +
+                                  'static;
+
+/// The getter of an indexed property handler.  Returns `None` if the property with the specified
+/// index should not be intercepted.
+pub type IndexedPropertyGetterCallback = Fn(u32, PropertyCallbackInfo)
+                                            -> Result<Option<ReturnValue>, Value> + 'static;
+
+/// The setter of an indexed property handler.  Returns `false` if the assignment should not be
+/// intercepted, in which case the property is set on the object as usual.
+pub type IndexedPropertySetterCallback = Fn(u32, Value, PropertyCallbackInfo)
+                                            -> Result<bool, Value> + 'static;
+
+/// The query callback of an indexed property handler.  Returns the attributes of the property
+/// with the specified index, or `None` if the property is not intercepted.
+pub type IndexedPropertyQueryCallback = Fn(u32, PropertyCallbackInfo)
+                                           -> Result<Option<PropertyAttributes>, Value> + 'static;
+
+/// The enumerator of a property handler.  Returns an array with the keys of all of the
+/// intercepted properties.
+pub type PropertyEnumeratorCallback = Fn(PropertyCallbackInfo) -> Result<Array, Value> + 'static;
+
+/// Callbacks that intercept all accesses to the indexed properties of an object.
+pub struct IndexedPropertyHandler {
+    pub getter: Box<IndexedPropertyGetterCallback>,
+    pub setter: Option<Box<IndexedPropertySetterCallback>>,
+    pub query: Option<Box<IndexedPropertyQueryCallback>>,
+    pub enumerator: Option<Box<PropertyEnumeratorCallback>>,
+}
+
+/// The getter of a named property handler.  Returns `None` if the property with the specified
+/// name should not be intercepted.
+pub type NamedPropertyGetterCallback = Fn(Name, PropertyCallbackInfo)
+                                          -> Result<Option<ReturnValue>, Value> + 'static;
+
+/// The setter of a named property handler.  Returns `false` if the assignment should not be
+/// intercepted, in which case the property is set on the object as usual.
+pub type NamedPropertySetterCallback = Fn(Name, Value, PropertyCallbackInfo)
+                                          -> Result<bool, Value> + 'static;
+
+/// The query callback of a named property handler.  Returns the attributes of the property with
+/// the specified name, or `None` if the property is not intercepted.
+pub type NamedPropertyQueryCallback = Fn(Name, PropertyCallbackInfo)
+                                         -> Result<Option<PropertyAttributes>, Value> + 'static;
+
+/// The deleter of a named property handler.  Returns whether the property was deleted, or `None`
+/// if the deletion should not be intercepted.
+pub type NamedPropertyDeleterCallback = Fn(Name, PropertyCallbackInfo)
+                                           -> Result<Option<bool>, Value> + 'static;
+
+/// Callbacks that intercept all accesses to the named properties of an object.
+pub struct NamedPropertyHandler {
+    pub getter: Box<NamedPropertyGetterCallback>,
+    pub setter: Option<Box<NamedPropertySetterCallback>>,
+    pub query: Option<Box<NamedPropertyQueryCallback>>,
+    pub deleter: Option<Box<NamedPropertyDeleterCallback>>,
+    pub enumerator: Option<Box<PropertyEnumeratorCallback>>,
+}
+
+/// A Rust value that can be converted into a Javascript value on demand.
+pub trait ToValue {
+    /// Converts this value into a Javascript value in the specified context.
+    fn to_value(&self, isolate: &isolate::Isolate, context: &context::Context) -> ReturnValue;
+}
+
+/// The attributes of a property.
+#[derive(Clone, Copy, Debug, Default, Eq, PartialEq)]
+pub struct PropertyAttributes {
+    pub read_only: bool,
+    pub dont_enum: bool,
+    pub dont_delete: bool,
+}
+
+/// Computes the value of a lazy data property the first time it is read.
+pub type LazyDataInitializer = Fn(PropertyCallbackInfo) -> Result<Value, Value> + 'static;
+
+/// A value returned from a property callback.
+///
+/// The primitive variants are handed directly to V8 without allocating a handle, so returning
+/// them is cheaper than returning an equivalent `Value`.
+#[derive(Debug)]
+pub enum ReturnValue {
+    Undefined,
+    Null,
+    Boolean(bool),
+    Int32(i32),
+    Uint32(u32),
+    Number(f64),
+    Value(Value),
+}
+
+impl ReturnValue {
+    /// Converts this return value into a Javascript value.
+    pub fn into_value(self, isolate: &isolate::Isolate) -> Value {
+        match self {
+            ReturnValue::Undefined => undefined(isolate).into(),
+            ReturnValue::Null => null(isolate).into(),
+            ReturnValue::Boolean(b) => Boolean::new(isolate, b).into(),
+            ReturnValue::Int32(i) => Integer::new(isolate, i).into(),
+            ReturnValue::Uint32(u) => Integer::new_from_unsigned(isolate, u).into(),
+            ReturnValue::Number(n) => Number::new(isolate, n).into(),
+            ReturnValue::Value(v) => v,
+        }
+    }
+}
+
 pub fn undefined(isolate: &isolate::Isolate) -> Primitive {
     let raw = unsafe { util::invoke(isolate, |c| v8::v8_Undefined(c)).unwrap() };
     Primitive(isolate.clone(), raw)
@@ -283,13 +405,27 @@ macro_rules! partial_conversion {
 }
 
 macro_rules! partial_get {
-    ($name:ident, $wrapped:expr, $target:ident) => {
+    ($name:ident, $try_name:ident, $wrapped:expr, $target:ident, $from_smi:expr) => {
+        /// Converts this value to a primitive, panicking if the conversion throws.
+        ///
+        /// The conversion takes at most one call into V8, and none if the value is a small
+        /// integer.
         pub fn $name(&self, context: &context::Context) -> $target {
+            self.$try_name(context).unwrap()
+        }
+
+        /// Converts this value to a primitive, returning the exception if the conversion throws
+        /// (for example, in a `valueOf` method).
+        pub fn $try_name(&self, context: &context::Context) -> error::Result<$target> {
+            if let Some(smi) = unsafe { util::smi_value(self.1) } {
+                return Ok($from_smi(smi));
+            }
+
             unsafe {
-                let maybe = util::invoke_ctx(&self.0, context, |c| $wrapped(c, self.1, context.as_raw())).unwrap();
+                let maybe = try!(util::invoke_ctx(&self.0, context, |c| $wrapped(c, self.1, context.as_raw())));
                 assert!( maybe.is_set);
 
-                maybe.value
+                Ok(maybe.value)
             }
         }
     }
@@ -562,6 +698,13 @@ impl Value {
               "",
               v8::v8_Value_IsProxy,
               Proxy);
+    downcast!(is_web_assembly_compiled_module,
+              "Returns true if this value is a compiled WebAssembly module.\n\nThis is an \
+               experimental feature.",
+              into_web_assembly_compiled_module,
+              "",
+              v8::v8_Value_IsWebAssemblyCompiledModule,
+              WasmCompiledModule);
 
     partial_conversion!(to_boolean, v8::v8_Value_ToBoolean, Boolean);
     partial_conversion!(to_number, v8::v8_Value_ToNumber, Number);
@@ -573,22 +716,31 @@ impl Value {
     partial_conversion!(to_int32, v8::v8_Value_ToInt32, Int32);
     partial_conversion!(to_array_index, v8::v8_Value_ToArrayIndex, Uint32);
 
-    pub fn boolean_value(&self, context: &context::Context) -> bool {
-        unsafe {
-            let m = util::invoke_ctx(&self.0,
-                                     context,
-                                     |i| v8::v8_Value_BooleanValue(i, self.1, context.as_raw()))
-                .unwrap();
-
-            assert!( m.is_set);
-             m.value
-        }
-    }
-
-    partial_get!(number_value, v8::v8_Value_NumberValue, f64);
-    partial_get!(integer_value, v8::v8_Value_IntegerValue, i64);
-    partial_get!(uint32_value, v8::v8_Value_Uint32Value, u32);
-    partial_get!(int32_value, v8::v8_Value_Int32Value, i32);
+    partial_get!(boolean_value,
+                 try_boolean_value,
+                 v8::v8_Value_BooleanValue,
+                 bool,
+                 |smi| smi != 0);
+    partial_get!(number_value,
+                 try_number_value,
+                 v8::v8_Value_NumberValue,
+                 f64,
+                 |smi| smi as f64);
+    partial_get!(integer_value,
+                 try_integer_value,
+                 v8::v8_Value_IntegerValue,
+                 i64,
+                 |smi| smi as i64);
+    partial_get!(uint32_value,
+                 try_uint32_value,
+                 v8::v8_Value_Uint32Value,
+                 u32,
+                 |smi| smi as u32);
+    partial_get!(int32_value,
+                 try_int32_value,
+                 v8::v8_Value_Int32Value,
+                 i32,
+                 |smi: i32| smi);
 
     pub fn equals(&self, context: &context::Context, that: &Value) -> bool {
         unsafe {
@@ -623,6 +775,112 @@ impl Value {
     pub fn as_raw(&self) -> v8::ValueRef {
         self.1
     }
+
+    /// Consumes this value and returns the underlying raw pointer.  The caller becomes responsible
+    /// for destroying the reference.
+    pub fn into_raw(self) -> v8::ValueRef {
+        let raw = self.1;
+        let isolate = unsafe { ptr::read(&self.0) };
+        mem::forget(self);
+        drop(isolate);
+        raw
+    }
+}
+
+impl PropertyAttributes {
+    /// Returns these attributes as the bit set that V8 uses to represent them.
+    pub fn bits(&self) -> i32 {
+        let mut result = v8::PropertyAttribute::PropertyAttribute_None as i32;
+
+        if self.read_only {
+            result |= v8::PropertyAttribute::PropertyAttribute_ReadOnly as i32;
+        }
+
+        if self.dont_enum {
+            result |= v8::PropertyAttribute::PropertyAttribute_DontEnum as i32;
+        }
+
+        if self.dont_delete {
+            result |= v8::PropertyAttribute::PropertyAttribute_DontDelete as i32;
+        }
+
+        result
+    }
+}
+
+macro_rules! primitive_to_value {
+    ($typ:ty) => {
+        impl ToValue for $typ {
+            fn to_value(&self, _: &isolate::Isolate, _: &context::Context) -> ReturnValue {
+                (*self).into()
+            }
+        }
+    }
+}
+
+primitive_to_value!(bool);
+primitive_to_value!(i32);
+primitive_to_value!(u32);
+primitive_to_value!(f64);
+
+impl ToValue for str {
+    fn to_value(&self, isolate: &isolate::Isolate, _: &context::Context) -> ReturnValue {
+        let string: Value = String::from_str(isolate, self).into();
+        ReturnValue::Value(string)
+    }
+}
+
+impl ToValue for ::std::string::String {
+    fn to_value(&self, isolate: &isolate::Isolate, context: &context::Context) -> ReturnValue {
+        self.as_str().to_value(isolate, context)
+    }
+}
+
+impl<A> ToValue for Option<A>
+    where A: ToValue
+{
+    fn to_value(&self, isolate: &isolate::Isolate, context: &context::Context) -> ReturnValue {
+        match *self {
+            Some(ref value) => value.to_value(isolate, context),
+            None => ReturnValue::Null,
+        }
+    }
+}
+
+impl ToValue for Value {
+    fn to_value(&self, _: &isolate::Isolate, _: &context::Context) -> ReturnValue {
+        ReturnValue::Value(self.clone())
+    }
+}
+
+impl From<Value> for ReturnValue {
+    fn from(value: Value) -> ReturnValue {
+        ReturnValue::Value(value)
+    }
+}
+
+impl From<bool> for ReturnValue {
+    fn from(value: bool) -> ReturnValue {
+        ReturnValue::Boolean(value)
+    }
+}
+
+impl From<i32> for ReturnValue {
+    fn from(value: i32) -> ReturnValue {
+        ReturnValue::Int32(value)
+    }
+}
+
+impl From<u32> for ReturnValue {
+    fn from(value: u32) -> ReturnValue {
+        ReturnValue::Uint32(value)
+    }
+}
+
+impl From<f64> for ReturnValue {
+    fn from(value: f64) -> ReturnValue {
+        ReturnValue::Number(value)
+    }
 }
 
 impl PartialEq for Value {
@@ -1026,6 +1284,56 @@ impl Object {
         }
     }
 
+    /// Sets an accessor property on this object.
+    ///
+    /// Whenever the property is read, the getter is called.  If a setter is specified, it is
+    /// called when the property is assigned; otherwise assignments are ignored.
+    pub fn set_accessor(&self,
+                        context: &context::Context,
+                        name: &Name,
+                        getter: Box<AccessorGetterCallback>,
+                        setter: Option<Box<AccessorSetterCallback>>)
+                        -> bool {
+        let has_setter = setter.is_some();
+        let data = util::accessor_data(&self.0, getter, setter);
+        unsafe {
+            let m = util::invoke_ctx(&self.0, context, |c| {
+                    v8::v8_Object_SetAccessor_Name(c,
+                                                self.1,
+                                                context.as_raw(),
+                                                name.as_raw(),
+                                                Some(util::accessor_getter),
+                                                if has_setter {
+                                                    Some(util::accessor_setter)
+                                                } else {
+                                                    None
+                                                },
+                                                data.as_raw() as v8::ValueRef,
+                                                v8::AccessControl::AccessControl_DEFAULT,
+                                                v8::PropertyAttribute::PropertyAttribute_None)
+                })
+                .unwrap();
+
+            assert!(m.is_set);
+            m.value
+        }
+    }
+
+    /// Sets a lazy data property on this object.
+    ///
+    /// The initializer runs the first time the property is read, and the value it returns then
+    /// replaces the property as an ordinary data property.  Assigning to the property before
+    /// reading it skips the initializer.  To offer the same lazy globals in many contexts, set
+    /// them on a global template instead (see `Context::new_with_global_template`).
+    pub fn set_lazy_data_property(&self,
+                                  context: &context::Context,
+                                  name: &Name,
+                                  initializer: Box<LazyDataInitializer>)
+                                  -> bool {
+        let accessor = util::lazy_data_accessor(initializer);
+        self.set_accessor(context, name, accessor.getter, accessor.setter)
+    }
+
     pub fn create_data_property_index(&self,
                                       context: &context::Context,
                                       index: u32,
@@ -1451,6 +1759,16 @@ impl Array {
         Array(isolate.clone(), raw)
     }
 
+    /// The number of elements in the array.
+    pub fn length(&self) -> u32 {
+        unsafe { util::invoke(&self.0, |c| v8::v8_Array_Length(c, self.1)).unwrap() as u32 }
+    }
+
+    /// Returns an iterator over the elements of the array, which are fetched in chunks.
+    pub fn iter(&self, context: &context::Context) -> iter::ArrayIter {
+        iter::ArrayIter::new(&self.0, context, self)
+    }
+
     /// Creates an array from a set of raw pointers.
     pub unsafe fn from_raw(isolate: &isolate::Isolate, raw: v8::ArrayRef) -> Array {
         Array(isolate.clone(), raw)
@@ -1526,6 +1844,11 @@ impl Map {
         Array(self.0.clone(), raw)
     }
 
+    /// Returns an iterator over the entries of the map, which are fetched in chunks.
+    pub fn iter(&self, context: &context::Context) -> iter::MapIter {
+        iter::MapIter::new(&self.0, context, self)
+    }
+
     /// Creates a map from a set of raw pointers.
     pub unsafe fn from_raw(isolate: &isolate::Isolate, raw: v8::MapRef) -> Map {
         Map(isolate.clone(), raw)
@@ -1591,6 +1914,11 @@ impl Set {
         Array(self.0.clone(), raw)
     }
 
+    /// Returns an iterator over the values of the set, which are fetched in chunks.
+    pub fn iter(&self, context: &context::Context) -> iter::SetIter {
+        iter::SetIter::new(&self.0, context, self)
+    }
+
     /// Creates a set from a set of raw pointers.
     pub unsafe fn from_raw(isolate: &isolate::Isolate, raw: v8::SetRef) -> Set {
         Set(isolate.clone(), raw)
@@ -1602,6 +1930,150 @@ impl Set {
     }
 }
 
+impl ArrayBuffer {
+    /// Creates a new ArrayBuffer holding a copy of the specified bytes.
+    pub fn from_bytes(isolate: &isolate::Isolate, bytes: &[u8]) -> ArrayBuffer {
+        let raw = unsafe {
+            util::invoke(isolate, |c| {
+                    v8::v8_ArrayBuffer_New_Copy(c,
+                                                bytes.as_ptr() as *const os::raw::c_void,
+                                                bytes.len())
+                })
+                .unwrap()
+        };
+        ArrayBuffer(isolate.clone(), raw)
+    }
+
+    /// Creates a new ArrayBuffer that takes ownership of the specified bytes without copying them.
+    pub fn from_vec(isolate: &isolate::Isolate, bytes: Vec<u8>) -> ArrayBuffer {
+        if bytes.is_empty() {
+            return ArrayBuffer::from_bytes(isolate, &[]);
+        }
+
+        // The array buffer allocator frees blocks as vectors whose capacity is their length
+        let bytes = bytes.into_boxed_slice();
+        let length = bytes.len();
+        let data = Box::into_raw(bytes) as *mut u8;
+
+        let raw = unsafe {
+            util::invoke(isolate, |c| {
+                    v8::v8_ArrayBuffer_New_Internalized(c, data as *mut os::raw::c_void, length)
+                })
+                .unwrap()
+        };
+        ArrayBuffer(isolate.clone(), raw)
+    }
+
+    /// Whether `detach` can take the bytes out of the buffer.
+    pub fn is_detachable(&self) -> bool {
+        unsafe { util::invoke(&self.0, |c| v8::v8_ArrayBuffer_IsDetachable(c, self.1)).unwrap() }
+    }
+
+    /// Takes the bytes out of the buffer without copying them, leaving the buffer detached with a
+    /// length of zero.
+    ///
+    /// Returns `None` if the buffer can't be detached, or if its memory is owned by someone else
+    /// (for example, the memory of a WebAssembly instance).
+    pub fn detach(&self) -> Option<Vec<u8>> {
+        let mut data = ptr::null_mut();
+        let mut byte_length = 0;
+
+        unsafe {
+            let detached = util::invoke(&self.0, |c| {
+                    v8::v8_ArrayBuffer_Detach(c, self.1, &mut data, &mut byte_length)
+                })
+                .unwrap();
+
+            if !detached {
+                None
+            } else if data.is_null() {
+                Some(Vec::new())
+            } else {
+                Some(Vec::from_raw_parts(data as *mut u8, byte_length, byte_length))
+            }
+        }
+    }
+
+    /// The length of the buffer in bytes.
+    pub fn byte_length(&self) -> usize {
+        unsafe { util::invoke(&self.0, |c| v8::v8_ArrayBuffer_ByteLength(c, self.1)).unwrap() }
+    }
+
+    /// Returns a pointer to the backing store of the buffer, and its length in bytes.
+    ///
+    /// The pointer is only valid until the buffer is detached or garbage collected.
+    pub unsafe fn contents(&self) -> (*mut u8, usize) {
+        let mut byte_length = 0;
+        let data = util::invoke(&self.0, |c| {
+                v8::v8_ArrayBuffer_GetContents_Data(c, self.1, &mut byte_length)
+            })
+            .unwrap();
+        (data as *mut u8, byte_length)
+    }
+
+    /// Creates an array buffer from a set of raw pointers.
+    pub unsafe fn from_raw(isolate: &isolate::Isolate, raw: v8::ArrayBufferRef) -> ArrayBuffer {
+        ArrayBuffer(isolate.clone(), raw)
+    }
+
+    /// Returns the underlying raw pointer behind this array buffer.
+    pub fn as_raw(&self) -> v8::ArrayBufferRef {
+        self.1
+    }
+}
+
+impl WasmCompiledModule {
+    /// Serializes the compiled code of the module, so that it can be restored with `deserialize`
+    /// by a later process running the same V8 version with the same flags.
+    pub fn serialize(&self) -> Vec<u8> {
+        let mut bytes = Vec::new();
+
+        unsafe {
+            util::invoke(&self.0, |c| {
+                    v8::v8_WasmCompiledModule_Serialize(c,
+                                                        self.1,
+                                                        Some(append_bytes),
+                                                        &mut bytes as *mut Vec<u8> as
+                                                        *mut os::raw::c_void)
+                })
+                .unwrap();
+        }
+
+        bytes
+    }
+
+    /// Restores a module that was serialized with `serialize`.
+    ///
+    /// Fails if the bytes were not produced by the same V8 version with the same flags.
+    pub fn deserialize(isolate: &isolate::Isolate,
+                       bytes: &[u8])
+                       -> error::Result<WasmCompiledModule> {
+        let raw = unsafe {
+            try!(util::invoke(isolate, |c| {
+                v8::v8_WasmCompiledModule_Deserialize(c, bytes.as_ptr(), bytes.len())
+            }))
+        };
+
+        if raw.is_null() {
+            Err("the serialized WebAssembly module was rejected".into())
+        } else {
+            Ok(WasmCompiledModule(isolate.clone(), raw))
+        }
+    }
+
+    /// Creates a module from a set of raw pointers.
+    pub unsafe fn from_raw(isolate: &isolate::Isolate,
+                           raw: v8::WasmCompiledModuleRef)
+                           -> WasmCompiledModule {
+        WasmCompiledModule(isolate.clone(), raw)
+    }
+
+    /// Returns the underlying raw pointer behind this module.
+    pub fn as_raw(&self) -> v8::WasmCompiledModuleRef {
+        self.1
+    }
+}
+
 impl Function {
     /// Create a function in the current execution context for a given callback.
     pub fn new(isolate: &isolate::Isolate,
@@ -1691,6 +2163,48 @@ impl External {
         External(isolate.clone(), raw)
     }
 
+    /// Creates a new external for a value that owns `size` bytes of memory outside of the V8
+    /// heap.
+    ///
+    /// The size is reported to V8 as externally allocated memory until the external is garbage
+    /// collected, so that garbage collection is scheduled according to the real memory usage.
+    pub unsafe fn new_with_size<A>(isolate: &isolate::Isolate,
+                                   value: *mut A,
+                                   size: usize)
+                                   -> External {
+        let external = External::new(isolate, value);
+        util::invoke(&isolate, |c| {
+                v8::v8_Value_SetWeakFinalizer(c,
+                                              external.1 as v8::ValueRef,
+                                              None,
+                                              ptr::null_mut(),
+                                              size as i64)
+            })
+            .unwrap();
+        external
+    }
+
+    /// Creates a new external that owns the specified value, which is dropped once the external
+    /// has been garbage collected.
+    pub fn new_owned<A>(isolate: &isolate::Isolate, value: Box<A>) -> External
+        where A: 'static
+    {
+        let value = Box::into_raw(value);
+
+        unsafe {
+            let external = External::new(isolate, value);
+            util::invoke(&isolate, |c| {
+                    v8::v8_Value_SetWeakFinalizer(c,
+                                                  external.1 as v8::ValueRef,
+                                                  Some(util::drop_in_finalizer::<A>),
+                                                  value as *mut os::raw::c_void,
+                                                  0)
+                })
+                .unwrap();
+            external
+        }
+    }
+
     pub unsafe fn value<A>(&self) -> *mut A {
         util::invoke(&self.0, |c| v8::v8_External_Value(c, self.1)).unwrap() as *mut A
     }
@@ -1868,6 +2382,9 @@ subtype!(DataView, Value);
 inherit!(SharedArrayBuffer, Object);
 subtype!(SharedArrayBuffer, Value);
 
+inherit!(WasmCompiledModule, Object);
+subtype!(WasmCompiledModule, Value);
+
 inherit!(Date, Object);
 subtype!(Date, Value);
 
@@ -1947,6 +2464,9 @@ reference!(DataView, v8::v8_DataView_CloneRef, v8::v8_DataView_DestroyRef);
 reference!(SharedArrayBuffer,
            v8::v8_SharedArrayBuffer_CloneRef,
            v8::v8_SharedArrayBuffer_DestroyRef);
+reference!(WasmCompiledModule,
+           v8::v8_WasmCompiledModule_CloneRef,
+           v8::v8_WasmCompiledModule_DestroyRef);
 reference!(Date, v8::v8_Date_CloneRef, v8::v8_Date_DestroyRef);
 reference!(NumberObject,
            v8::v8_NumberObject_CloneRef,
@@ -1963,3 +2483,10 @@ reference!(SymbolObject,
 reference!(RegExp, v8::v8_RegExp_CloneRef, v8::v8_RegExp_DestroyRef);
 reference!(External, v8::v8_External_CloneRef, v8::v8_External_DestroyRef);
 reference!(Exception, v8::v8_Exception_CloneRef, v8::v8_Exception_DestroyRef);
+
+extern "C" fn append_bytes(sink: *mut os::raw::c_void, data: *const u8, length: usize) {
+    unsafe {
+        let sink = &mut *(sink as *mut Vec<u8>);
+        sink.extend_from_slice(slice::from_raw_parts(data, length));
+    }
+}
@@ -0,0 +1,629 @@
+//! Compiling and running WebAssembly modules.
+//!
+//! Modules are compiled and instantiated through the `WebAssembly` Javascript API of a context,
+//! which this generation of V8 only installs when the `--expose-wasm` flag is set (see
+//! [`expose`](fn.expose.html)).  Compiled modules can be serialized, and a
+//! [`ModuleCache`](struct.ModuleCache.html) uses that to keep compiled modules on disk, so that a
+//! module only has to be compiled the first time it is loaded.
+//!
+//! The linear memory of an instance can be accessed from Rust without copying, through a
+//! [`MemoryView`](struct.MemoryView.html) of a [`WasmMemory`](struct.WasmMemory.html) that is
+//! only lent to a closure.
+use context;
+use error;
+use flags;
+use isolate;
+use value;
+use std::fs;
+use std::io;
+use std::io::{Read, Write};
+use std::mem;
+use std::ops;
+use std::path;
+use std::ptr;
+use std::slice;
+use std::time;
+
+/// A compiled WebAssembly module.
+#[derive(Clone, Debug)]
+pub struct WasmModule {
+    isolate: isolate::Isolate,
+    module: value::WasmCompiledModule,
+}
+
+/// An instance of a WebAssembly module, with its own memory and exports.
+#[derive(Clone, Debug)]
+pub struct WasmInstance {
+    isolate: isolate::Isolate,
+    instance: value::Object,
+    exports: value::Object,
+}
+
+/// The size of a page of WebAssembly memory, in bytes.
+pub const PAGE_SIZE: usize = 65536;
+
+/// A `WebAssembly.Memory`, that is the linear memory of an instance.
+///
+/// The location of the backing store is cached between views, and re-validated with a single call
+/// into V8 before every view, since growing the memory moves it.
+#[derive(Debug)]
+pub struct WasmMemory {
+    isolate: isolate::Isolate,
+    context: context::Context,
+    memory: value::Object,
+    backing: Option<Backing>,
+}
+
+/// A scoped view of the bytes of a memory.
+///
+/// Views are lent out by [`WasmMemory::with_view`](struct.WasmMemory.html#method.with_view), for
+/// the duration of a closure that can't call back into V8.
+#[derive(Debug)]
+pub struct MemoryView<'a> {
+    bytes: &'a mut [u8],
+}
+
+#[derive(Debug)]
+struct Backing {
+    buffer: value::ArrayBuffer,
+    data: *mut u8,
+    length: usize,
+}
+
+/// The imports to instantiate a module with.
+///
+/// Imports are grouped by module name, like the import object of `WebAssembly.Instance`.
+#[derive(Debug)]
+pub struct Imports {
+    isolate: isolate::Isolate,
+    context: context::Context,
+    object: value::Object,
+}
+
+/// A cache of compiled modules in a directory on disk.
+///
+/// Modules are found by a hash of their bytes, and every entry also stores the bytes that it was
+/// compiled from, which are compared on load, so a hash collision is only a cache miss.  A cached
+/// module that was compiled by a different V8 version or with different flags is rejected by V8,
+/// and is then compiled again and replaced.
+#[derive(Debug)]
+pub struct ModuleCache {
+    directory: path::PathBuf,
+    stats: Stats,
+}
+
+/// Counters describing how well a module cache is doing.
+#[derive(Clone, Copy, Debug, Default, Eq, PartialEq)]
+pub struct Stats {
+    /// The number of loads that were served from the cache.
+    pub hits: u64,
+    /// The number of loads that had to compile the module.
+    pub misses: u64,
+}
+
+/// Sets the V8 flag that installs the `WebAssembly` object in new contexts.
+///
+/// Only contexts created after the call are affected.
+pub fn expose() {
+    flags::set_from_string("--expose_wasm");
+}
+
+impl WasmModule {
+    /// Compiles a module from its binary encoding.
+    ///
+    /// Fails if the bytes are not a valid module, or if WebAssembly is not exposed in the context.
+    pub fn compile(isolate: &isolate::Isolate,
+                   context: &context::Context,
+                   bytes: &[u8])
+                   -> error::Result<WasmModule> {
+        let constructor = try!(web_assembly_constructor(isolate, context, "Module"));
+        let buffer: value::Value = value::ArrayBuffer::from_bytes(isolate, bytes).into();
+        let module = try!(constructor.call_as_constructor(context, &[&buffer]));
+
+        match module.into_web_assembly_compiled_module() {
+            Some(module) => {
+                Ok(WasmModule {
+                    isolate: isolate.clone(),
+                    module: module,
+                })
+            }
+            None => Err("WebAssembly.Module did not return a compiled module".into()),
+        }
+    }
+
+    /// Restores a module that was serialized with `serialize`.
+    ///
+    /// Fails if the bytes were not produced by the same V8 version with the same flags.
+    pub fn deserialize(isolate: &isolate::Isolate, bytes: &[u8]) -> error::Result<WasmModule> {
+        let module = try!(value::WasmCompiledModule::deserialize(isolate, bytes));
+
+        Ok(WasmModule {
+            isolate: isolate.clone(),
+            module: module,
+        })
+    }
+
+    /// Serializes the compiled code of the module.
+    pub fn serialize(&self) -> Vec<u8> {
+        self.module.serialize()
+    }
+
+    /// Creates a new instance of the module with the specified imports.
+    ///
+    /// Fails if an import is missing or has the wrong type, or if the start function of the
+    /// module throws.
+    pub fn instantiate(&self,
+                       context: &context::Context,
+                       imports: &Imports)
+                       -> error::Result<WasmInstance> {
+        let constructor = try!(web_assembly_constructor(&self.isolate, context, "Instance"));
+        let module: value::Value = self.module.clone().into();
+        let imports: value::Value = imports.object.clone().into();
+        let instance = try!(constructor.call_as_constructor(context, &[&module, &imports]));
+
+        let instance = match instance.into_object() {
+            Some(instance) => instance,
+            None => return Err("WebAssembly.Instance did not return an object".into()),
+        };
+
+        let key = value::String::from_str(&self.isolate, "exports");
+        let exports = match instance.get(context, &key).into_object() {
+            Some(exports) => exports,
+            None => return Err("the WebAssembly instance has no exports object".into()),
+        };
+
+        Ok(WasmInstance {
+            isolate: self.isolate.clone(),
+            instance: instance,
+            exports: exports,
+        })
+    }
+
+    /// The underlying compiled module value.
+    pub fn as_compiled_module(&self) -> &value::WasmCompiledModule {
+        &self.module
+    }
+}
+
+impl WasmInstance {
+    /// The exports object of the instance.
+    pub fn exports(&self) -> &value::Object {
+        &self.exports
+    }
+
+    /// Returns the exported function with the specified name.
+    pub fn get_function(&self,
+                        context: &context::Context,
+                        name: &str)
+                        -> error::Result<value::Function> {
+        let key = value::String::from_str(&self.isolate, name);
+
+        match self.exports.get(context, &key).into_function() {
+            Some(function) => Ok(function),
+            None => Err(format!("the WebAssembly instance does not export a function {:?}", name)
+                .into()),
+        }
+    }
+
+    /// Returns the exported memory with the specified name.
+    pub fn get_memory(&self,
+                      context: &context::Context,
+                      name: &str)
+                      -> error::Result<WasmMemory> {
+        let key = value::String::from_str(&self.isolate, name);
+
+        match self.exports.get(context, &key).into_object() {
+            Some(memory) => Ok(WasmMemory::from_object(&self.isolate, context, memory)),
+            None => Err(format!("the WebAssembly instance does not export a memory {:?}", name)
+                .into()),
+        }
+    }
+
+    /// The underlying `WebAssembly.Instance` object.
+    pub fn as_object(&self) -> &value::Object {
+        &self.instance
+    }
+}
+
+impl WasmMemory {
+    /// Creates a new memory with the specified initial and maximum number of pages, for example to
+    /// pass as an import.
+    pub fn new(isolate: &isolate::Isolate,
+               context: &context::Context,
+               initial_pages: u32,
+               maximum_pages: Option<u32>)
+               -> error::Result<WasmMemory> {
+        let constructor = try!(web_assembly_constructor(isolate, context, "Memory"));
+        let descriptor = value::Object::new(isolate, context);
+
+        let initial_key = value::String::from_str(isolate, "initial");
+        descriptor.set(context,
+                       &initial_key,
+                       &value::Integer::new_from_unsigned(isolate, initial_pages));
+
+        if let Some(maximum_pages) = maximum_pages {
+            let maximum_key = value::String::from_str(isolate, "maximum");
+            descriptor.set(context,
+                           &maximum_key,
+                           &value::Integer::new_from_unsigned(isolate, maximum_pages));
+        }
+
+        let descriptor: value::Value = descriptor.into();
+        let memory = try!(constructor.call_as_constructor(context, &[&descriptor]));
+
+        match memory.into_object() {
+            Some(memory) => Ok(WasmMemory::from_object(isolate, context, memory)),
+            None => Err("WebAssembly.Memory did not return an object".into()),
+        }
+    }
+
+    /// Wraps an existing `WebAssembly.Memory` object.
+    pub fn from_object(isolate: &isolate::Isolate,
+                       context: &context::Context,
+                       memory: value::Object)
+                       -> WasmMemory {
+        WasmMemory {
+            isolate: isolate.clone(),
+            context: context.clone(),
+            memory: memory,
+            backing: None,
+        }
+    }
+
+    /// Calls the specified closure with a view of the current bytes of the memory, returning what
+    /// the closure returns.
+    ///
+    /// The closure has to be `Send`, which keeps it from capturing isolates, contexts or values:
+    /// it can't run code that grows or otherwise touches the memory while it holds the view,
+    /// including through another `WasmMemory` wrapping the same object.
+    ///
+    /// Fails if the object is not a `WebAssembly.Memory`.
+    pub fn with_view<F, R>(&mut self, f: F) -> error::Result<R>
+        where F: FnOnce(&mut MemoryView) -> R + Send
+    {
+        let mut view = try!(unsafe { self.view() });
+        Ok(f(&mut view))
+    }
+
+    /// Returns a view of the current bytes of the memory.
+    ///
+    /// Fails if the object is not a `WebAssembly.Memory`.
+    ///
+    /// # Safety
+    ///
+    /// The view must not be used after running any Javascript or WebAssembly code that might grow
+    /// the memory, since that leaves it pointing at the old backing store.  It must also not be
+    /// alive at the same time as another view of the same memory object, including one obtained
+    /// through a different `WasmMemory`.
+    pub unsafe fn view(&mut self) -> error::Result<MemoryView> {
+        try!(self.validate());
+
+        let backing = self.backing.as_ref().unwrap();
+        let bytes = if backing.length == 0 {
+            Default::default()
+        } else {
+            slice::from_raw_parts_mut(backing.data, backing.length)
+        };
+
+        Ok(MemoryView { bytes: bytes })
+    }
+
+    /// The current size of the memory, in bytes.
+    pub fn byte_length(&mut self) -> error::Result<usize> {
+        try!(self.validate());
+        Ok(self.backing.as_ref().unwrap().length)
+    }
+
+    /// Grows the memory by the specified number of pages, returning the previous number of pages.
+    ///
+    /// Fails if the memory would grow beyond its maximum.
+    pub fn grow(&mut self, delta_pages: u32) -> error::Result<u32> {
+        self.backing = None;
+
+        let key = value::String::from_str(&self.isolate, "grow");
+        let grow = match self.memory.get(&self.context, &key).into_function() {
+            Some(grow) => grow,
+            None => return Err("the object is not a WebAssembly.Memory".into()),
+        };
+
+        let delta: value::Value = value::Integer::new_from_unsigned(&self.isolate, delta_pages)
+            .into();
+        let previous = try!(grow.call_with_this(&self.context, &self.memory, &[&delta]));
+
+        previous.try_uint32_value(&self.context)
+    }
+
+    /// The underlying `WebAssembly.Memory` object.
+    pub fn as_object(&self) -> &value::Object {
+        &self.memory
+    }
+
+    fn validate(&mut self) -> error::Result<()> {
+        // A grown memory detaches its old buffer, which then has a length of zero.  That can't be
+        // told apart from a memory that is still empty, so an empty buffer is always fetched anew.
+        let valid = match self.backing {
+            Some(ref backing) => {
+                backing.length != 0 && backing.buffer.byte_length() == backing.length
+            }
+            None => false,
+        };
+
+        if valid {
+            return Ok(());
+        }
+
+        let key = value::String::from_str(&self.isolate, "buffer");
+        let buffer = match self.memory.get(&self.context, &key).into_array_buffer() {
+            Some(buffer) => buffer,
+            None => return Err("the object is not a WebAssembly.Memory".into()),
+        };
+        let (data, length) = unsafe { buffer.contents() };
+
+        self.backing = Some(Backing {
+            buffer: buffer,
+            data: data,
+            length: length,
+        });
+
+        Ok(())
+    }
+}
+
+macro_rules! memory_access {
+    ($read:ident, $write:ident, $ty:ty, $bits:ty, $from_bits:expr, $to_bits:expr) => {
+        /// Reads a little-endian value at the specified byte offset.
+        pub fn $read(&self, offset: usize) -> error::Result<$ty> {
+            try!(self.bounds(offset, mem::size_of::<$ty>()));
+            let start = unsafe { self.bytes.as_ptr().offset(offset as isize) };
+            let bits = unsafe { ptr::read_unaligned(start as *const $bits) };
+            Ok($from_bits(<$bits>::from_le(bits)))
+        }
+
+        /// Writes a little-endian value at the specified byte offset.
+        pub fn $write(&mut self, offset: usize, value: $ty) -> error::Result<()> {
+            try!(self.bounds(offset, mem::size_of::<$ty>()));
+            let start = unsafe { self.bytes.as_mut_ptr().offset(offset as isize) };
+            unsafe { ptr::write_unaligned(start as *mut $bits, $to_bits(value).to_le()) };
+            Ok(())
+        }
+    }
+}
+
+impl<'a> MemoryView<'a> {
+    memory_access!(read_u8, write_u8, u8, u8, |b| b, |v| v);
+    memory_access!(read_u16, write_u16, u16, u16, |b| b, |v| v);
+    memory_access!(read_u32, write_u32, u32, u32, |b| b, |v| v);
+    memory_access!(read_u64, write_u64, u64, u64, |b| b, |v| v);
+    memory_access!(read_i32, write_i32, i32, u32, |b| b as i32, |v| v as u32);
+    memory_access!(read_i64, write_i64, i64, u64, |b| b as i64, |v| v as u64);
+    memory_access!(read_f32, write_f32, f32, u32, f32::from_bits, f32::to_bits);
+    memory_access!(read_f64, write_f64, f64, u64, f64::from_bits, f64::to_bits);
+
+    /// Returns the bytes in the specified range.
+    pub fn read_bytes(&self, offset: usize, length: usize) -> error::Result<&[u8]> {
+        try!(self.bounds(offset, length));
+        Ok(&self.bytes[offset..offset + length])
+    }
+
+    /// Copies the specified bytes into the memory at the specified offset.
+    pub fn write_bytes(&mut self, offset: usize, bytes: &[u8]) -> error::Result<()> {
+        try!(self.bounds(offset, bytes.len()));
+        self.bytes[offset..offset + bytes.len()].copy_from_slice(bytes);
+        Ok(())
+    }
+
+    fn bounds(&self, offset: usize, length: usize) -> error::Result<()> {
+        match offset.checked_add(length) {
+            Some(end) if end <= self.bytes.len() => Ok(()),
+            _ => {
+                Err(format!("out of bounds memory access at {}+{} (memory size {})",
+                            offset,
+                            length,
+                            self.bytes.len())
+                    .into())
+            }
+        }
+    }
+}
+
+impl<'a> ops::Deref for MemoryView<'a> {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        self.bytes
+    }
+}
+
+impl<'a> ops::DerefMut for MemoryView<'a> {
+    fn deref_mut(&mut self) -> &mut [u8] {
+        self.bytes
+    }
+}
+
+impl Imports {
+    /// Creates an empty set of imports.
+    pub fn new(isolate: &isolate::Isolate, context: &context::Context) -> Imports {
+        Imports {
+            isolate: isolate.clone(),
+            context: context.clone(),
+            object: value::Object::new(isolate, context),
+        }
+    }
+
+    /// Adds a Rust function as the import with the specified module and field name.
+    pub fn add_function(&mut self,
+                        module: &str,
+                        name: &str,
+                        length: usize,
+                        callback: Box<value::FunctionCallback>) {
+        let function = value::Function::new(&self.isolate, &self.context, length, callback);
+        self.add_value(module, name, &function);
+    }
+
+    /// Adds a Javascript value, such as a number or a `WebAssembly.Memory`, as the import with the
+    /// specified module and field name.
+    pub fn add_value(&mut self, module: &str, name: &str, value: &value::Value) {
+        let namespace = self.namespace(module);
+        let key = value::String::from_str(&self.isolate, name);
+        namespace.set(&self.context, &key, value);
+    }
+
+    /// The import object, in the shape expected by `WebAssembly.Instance`.
+    pub fn as_object(&self) -> &value::Object {
+        &self.object
+    }
+
+    fn namespace(&self, module: &str) -> value::Object {
+        let key = value::String::from_str(&self.isolate, module);
+
+        if let Some(namespace) = self.object.get(&self.context, &key).into_object() {
+            return namespace;
+        }
+
+        let namespace = value::Object::new(&self.isolate, &self.context);
+        self.object.set(&self.context, &key, &namespace);
+        namespace
+    }
+}
+
+impl ModuleCache {
+    /// Creates a cache that keeps compiled modules in the specified directory.
+    ///
+    /// The directory is created when the first module is stored.
+    pub fn new<P>(directory: P) -> ModuleCache
+        where P: Into<path::PathBuf>
+    {
+        ModuleCache {
+            directory: directory.into(),
+            stats: Stats::default(),
+        }
+    }
+
+    /// Returns the module with the specified binary encoding, from the cache if possible.
+    ///
+    /// A module that is not in the cache is compiled and stored.  Failing to store a module is not
+    /// an error; the module is simply compiled again the next time it is loaded.
+    pub fn load(&mut self,
+                isolate: &isolate::Isolate,
+                context: &context::Context,
+                bytes: &[u8])
+                -> error::Result<WasmModule> {
+        let path = self.path(bytes);
+
+        if let Ok(entry) = read_file(&path) {
+            if let Some(serialized) = entry_module(&entry, bytes) {
+                if let Ok(module) = WasmModule::deserialize(isolate, serialized) {
+                    self.stats.hits += 1;
+                    return Ok(module);
+                }
+            }
+        }
+
+        self.stats.misses += 1;
+
+        let module = try!(WasmModule::compile(isolate, context, bytes));
+        let _ = self.store(&path, bytes, &module.serialize());
+        Ok(module)
+    }
+
+    /// The directory that modules are cached in.
+    pub fn directory(&self) -> &path::Path {
+        &self.directory
+    }
+
+    /// Returns the hit and miss counters of the cache.
+    pub fn stats(&self) -> Stats {
+        self.stats
+    }
+
+    fn path(&self, bytes: &[u8]) -> path::PathBuf {
+        self.directory.join(format!("{:016x}-{}.wasm-cache", fnv1a(bytes), bytes.len()))
+    }
+
+    fn store(&self, path: &path::Path, bytes: &[u8], serialized: &[u8]) -> io::Result<()> {
+        try!(fs::create_dir_all(&self.directory));
+
+        // Renaming a complete file into place keeps concurrent loads from reading a partial one
+        let nonce = time::SystemTime::now()
+            .duration_since(time::UNIX_EPOCH)
+            .map(|d| d.subsec_nanos())
+            .unwrap_or(0);
+        let temporary = path.with_extension(format!("tmp{}", nonce));
+
+        {
+            let mut file = try!(fs::File::create(&temporary));
+            try!(file.write_all(&encode_u64(bytes.len() as u64)));
+            try!(file.write_all(bytes));
+            try!(file.write_all(serialized));
+        }
+
+        fs::rename(&temporary, path)
+    }
+}
+
+fn web_assembly_constructor(isolate: &isolate::Isolate,
+                            context: &context::Context,
+                            name: &str)
+                            -> error::Result<value::Object> {
+    let key = value::String::from_str(isolate, "WebAssembly");
+    let web_assembly = match context.global().get(context, &key).into_object() {
+        Some(web_assembly) => web_assembly,
+        None => return Err("WebAssembly is not exposed in this context".into()),
+    };
+
+    let key = value::String::from_str(isolate, name);
+    match web_assembly.get(context, &key).into_object() {
+        Some(constructor) => Ok(constructor),
+        None => Err(format!("WebAssembly.{} is not available", name).into()),
+    }
+}
+
+fn read_file(path: &path::Path) -> io::Result<Vec<u8>> {
+    let mut bytes = Vec::new();
+    try!(try!(fs::File::open(path)).read_to_end(&mut bytes));
+    Ok(bytes)
+}
+
+/// Returns the serialized module of a cache entry, if the entry was stored for the specified
+/// module bytes.
+///
+/// An entry is the length of the module bytes as a little-endian `u64`, the module bytes and then
+/// the serialized module.
+fn entry_module<'a>(entry: &'a [u8], bytes: &[u8]) -> Option<&'a [u8]> {
+    let header = mem::size_of::<u64>();
+
+    if entry.len() < header || &entry[..header] != &encode_u64(bytes.len() as u64)[..] {
+        return None;
+    }
+
+    let rest = &entry[header..];
+
+    if rest.len() < bytes.len() || &rest[..bytes.len()] != bytes {
+        return None;
+    }
+
+    Some(&rest[bytes.len()..])
+}
+
+fn encode_u64(value: u64) -> [u8; 8] {
+    let mut encoded = [0; 8];
+
+    for (i, byte) in encoded.iter_mut().enumerate() {
+        *byte = (value >> (i * 8)) as u8;
+    }
+
+    encoded
+}
+
+/// The 64-bit FNV-1a hash, which unlike the standard library hashers is stable across Rust
+/// releases, as keys of an on-disk cache need to be.
+fn fnv1a(bytes: &[u8]) -> u64 {
+    let mut hash = 0xcbf29ce484222325u64;
+
+    for &byte in bytes {
+        hash ^= byte as u64;
+        hash = hash.wrapping_mul(0x100000001b3);
+    }
+
+    hash
+}
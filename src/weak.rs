@@ -0,0 +1,141 @@
+//! Weak handles that do not keep their values alive.
+//!
+//! All other handle types in this crate are strong: as long as the handle exists, the garbage
+//! collector will not reclaim the value.  A [`Weak`](struct.Weak.html) handle instead lets the
+//! value be collected, after which the handle becomes empty.  This makes it possible to build
+//! caches keyed on Javascript objects that do not leak.
+//!
+//! A weak handle can have a finalizer attached.  Finalizers are not run during garbage collection;
+//! they are enqueued on the isolate and run in batches by `Isolate::run_finalizers`.
+use v8_sys as v8;
+use isolate;
+use util;
+use value;
+use std::fmt;
+use std::marker;
+use std::os;
+use std::ptr;
+
+/// A handle to a value that does not prevent the value from being garbage collected.
+pub struct Weak<T> {
+    isolate: isolate::Isolate,
+    raw: v8::WeakRef,
+    phantom: marker::PhantomData<T>,
+}
+
+/// A handle type that can be referenced weakly.
+pub trait Referent: Sized {
+    /// Creates a handle from a raw value pointer.
+    unsafe fn from_value_raw(isolate: &isolate::Isolate, raw: v8::ValueRef) -> Self;
+
+    /// Returns the handle's underlying raw pointer as a value pointer.
+    fn as_value_raw(&self) -> v8::ValueRef;
+}
+
+impl<T> Weak<T>
+    where T: Referent
+{
+    /// Creates a new weak handle to the specified value.
+    pub fn new(isolate: &isolate::Isolate, value: &T) -> Weak<T> {
+        Weak::new_inner(isolate, value, None)
+    }
+
+    /// Creates a new weak handle to the specified value, with a finalizer that will be enqueued on
+    /// the isolate once the value has been garbage collected.
+    ///
+    /// The finalizer is not run if the handle is dropped before the value is collected.
+    pub fn with_finalizer<F>(isolate: &isolate::Isolate, value: &T, finalizer: F) -> Weak<T>
+        where F: FnOnce() + 'static
+    {
+        Weak::new_inner(isolate, value, Some(isolate::Finalizer::new(finalizer)))
+    }
+
+    fn new_inner(isolate: &isolate::Isolate,
+                 value: &T,
+                 finalizer: Option<isolate::Finalizer>)
+                 -> Weak<T> {
+        let (callback, parameter) = match finalizer {
+            Some(finalizer) => {
+                (Some(enqueue_finalizer as extern "C" fn(v8::IsolatePtr, *mut os::raw::c_void)),
+                 Box::into_raw(Box::new(finalizer)) as *mut os::raw::c_void)
+            }
+            None => (None, ptr::null_mut()),
+        };
+
+        let raw = unsafe {
+            util::invoke(isolate,
+                         |c| v8::v8_Weak_New(c, value.as_value_raw(), callback, parameter))
+                .unwrap()
+        };
+
+        Weak {
+            isolate: isolate.clone(),
+            raw: raw,
+            phantom: marker::PhantomData,
+        }
+    }
+
+    /// Returns a strong handle to the value, or `None` if it has been garbage collected.
+    pub fn upgrade(&self) -> Option<T> {
+        unsafe {
+            let raw = util::invoke(&self.isolate, |c| v8::v8_Weak_Get(c, self.raw)).unwrap();
+
+            if raw.is_null() {
+                None
+            } else {
+                Some(T::from_value_raw(&self.isolate, raw))
+            }
+        }
+    }
+
+    /// Whether the value has been garbage collected.
+    pub fn is_empty(&self) -> bool {
+        self.upgrade().is_none()
+    }
+}
+
+impl<T> fmt::Debug for Weak<T> {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "Weak({:?})", self.raw)
+    }
+}
+
+impl<T> Drop for Weak<T> {
+    fn drop(&mut self) {
+        unsafe {
+            let parameter = v8::v8_Weak_Destroy(self.raw);
+
+            if !parameter.is_null() {
+                drop(Box::from_raw(parameter as *mut isolate::Finalizer));
+            }
+        }
+    }
+}
+
+extern "C" fn enqueue_finalizer(raw: v8::IsolatePtr, parameter: *mut os::raw::c_void) {
+    unsafe {
+        let finalizer = *Box::from_raw(parameter as *mut isolate::Finalizer);
+        isolate::Isolate::from_raw(raw).enqueue_finalizer(finalizer);
+    }
+}
+
+macro_rules! referent {
+    ($typ:ident, $raw:ident) => {
+        impl Referent for value::$typ {
+            unsafe fn from_value_raw(isolate: &isolate::Isolate, raw: v8::ValueRef) -> Self {
+                value::$typ::from_raw(isolate, raw as v8::$raw)
+            }
+
+            fn as_value_raw(&self) -> v8::ValueRef {
+                self.as_raw() as v8::ValueRef
+            }
+        }
+    }
+}
+
+referent!(Value, ValueRef);
+referent!(Object, ObjectRef);
+referent!(Array, ArrayRef);
+referent!(Map, MapRef);
+referent!(Set, SetRef);
+referent!(Function, FunctionRef);
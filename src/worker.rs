@@ -0,0 +1,754 @@
+//! Javascript-visible worker threads.
+//!
+//! Workers are opt-in: `install` defines a `Worker` constructor in a context, and a script that
+//! calls `new Worker(source)` gets the source run in a new isolate on a thread of a
+//! [`WorkerPool`](struct.WorkerPool.html).  The two sides talk through `postMessage(message,
+//! transfer)` and `onmessage` handlers, like web workers; a worker can also call `close()`, and
+//! the parent `terminate()`.
+//!
+//! Messages are structured clones of primitives, arrays, plain objects and `ArrayBuffer`s.  As with
+//! structured cloning, an object that is reachable several times, including through a cycle, is
+//! cloned once and the clone shared.  Array buffers listed in the transfer list are moved to the
+//! receiving isolate without copying, and are detached in the sender.  This generation of V8 has
+//! no `ValueSerializer`, so messages are cloned through an owned Rust representation instead.
+//!
+//! The parent isolate is single threaded, so messages from workers are only delivered when the
+//! embedder calls `dispatch`, typically next to `Isolate::run_enqueued_tasks`.  Each
+//! [`Tenant`](struct.Tenant.html) of a pool has its own bound on the number of workers that may
+//! exist at the same time; `new Worker` throws once it is reached.
+use v8_sys as v8;
+use affinity;
+use context;
+use error;
+use isolate;
+use object_map;
+use script;
+use value;
+use std::cell;
+use std::collections;
+use std::panic;
+use std::rc;
+use std::sync;
+use std::sync::atomic;
+use std::sync::mpsc;
+use std::thread;
+
+/// The maximum nesting depth of a message.
+const MAX_DEPTH: usize = 100;
+
+/// A pool of threads that workers run on.
+///
+/// Every running worker occupies one thread of the pool for its whole life; workers started while
+/// all threads are busy wait for one to become free.
+#[derive(Clone, Debug)]
+pub struct WorkerPool {
+    jobs: sync::Arc<sync::Mutex<mpsc::Sender<Job>>>,
+}
+
+/// A share of a worker pool with its own bound on the number of workers.
+#[derive(Clone, Debug)]
+pub struct Tenant {
+    pool: WorkerPool,
+    max_workers: usize,
+    active: sync::Arc<atomic::AtomicUsize>,
+}
+
+/// The state of the workers of a context, kept in a slot of the context.
+struct Host {
+    tenant: Tenant,
+    workers: cell::RefCell<Vec<Running>>,
+}
+
+/// A worker as seen from its parent.
+struct Running {
+    object: value::Object,
+    channel: rc::Rc<Channel>,
+    events: mpsc::Receiver<Event>,
+}
+
+/// The parent end of the connection to a worker.
+#[derive(Debug)]
+struct Channel {
+    commands: mpsc::Sender<Command>,
+    isolate: sync::Arc<sync::Mutex<Option<IsolatePtr>>>,
+    terminated: sync::Arc<atomic::AtomicBool>,
+}
+
+#[derive(Debug)]
+struct Job {
+    source: String,
+    commands: mpsc::Receiver<Command>,
+    events: mpsc::Sender<Event>,
+    isolate: sync::Arc<sync::Mutex<Option<IsolatePtr>>>,
+    terminated: sync::Arc<atomic::AtomicBool>,
+    active: sync::Arc<atomic::AtomicUsize>,
+}
+
+/// Releases the slot of a job in its tenant and reports its exit, however the job ends.
+struct JobExit {
+    events: mpsc::Sender<Event>,
+    active: sync::Arc<atomic::AtomicUsize>,
+}
+
+/// Publishes the isolate of a running job, so that it can be terminated from another thread,
+/// until the guard is dropped.
+struct Published<'a>(&'a sync::Mutex<Option<IsolatePtr>>);
+
+/// The isolate of a running worker, which is only used to terminate it from another thread.
+#[derive(Debug)]
+struct IsolatePtr(v8::IsolatePtr);
+
+unsafe impl Send for IsolatePtr {}
+
+#[derive(Debug)]
+enum Command {
+    Message(Envelope),
+    Terminate,
+}
+
+#[derive(Debug)]
+enum Event {
+    Message(Envelope),
+    Error(String),
+    Exit,
+}
+
+/// A message together with the array buffers that were transferred along with it.
+#[derive(Debug)]
+struct Envelope {
+    message: Message,
+    transferred: Vec<Vec<u8>>,
+}
+
+#[derive(Debug)]
+enum Message {
+    Undefined,
+    Null,
+    Boolean(bool),
+    Number(f64),
+    String(String),
+    Array(Vec<Message>),
+    Object(Vec<(String, Message)>),
+    ArrayBuffer(Vec<u8>),
+    Transferred(usize),
+    /// An object that already occurs earlier in the message, by the order in which objects are
+    /// first reached.
+    Reference(usize),
+}
+
+impl WorkerPool {
+    /// Creates a pool with the specified number of threads.
+    pub fn new(threads: usize) -> WorkerPool {
+        let (sender, receiver) = mpsc::channel::<Job>();
+        let receiver = sync::Arc::new(sync::Mutex::new(receiver));
+
+        for _ in 0..threads {
+            let receiver = receiver.clone();
+            thread::spawn(move || {
+                // An unpinned worker still works, just without the locality
+                let _ = affinity::pin_isolate_thread();
+
+                loop {
+                    let job = receiver.lock().unwrap().recv();
+                    match job {
+                        // A panicking job reports its exit on the way out, and the thread is
+                        // kept for the next one
+                        Ok(job) => {
+                            let _ = panic::catch_unwind(panic::AssertUnwindSafe(|| job.run()));
+                        }
+                        Err(_) => break,
+                    }
+                }
+            });
+        }
+
+        WorkerPool { jobs: sync::Arc::new(sync::Mutex::new(sender)) }
+    }
+
+    /// Creates a tenant of this pool that may have at most the specified number of workers.
+    pub fn tenant(&self, max_workers: usize) -> Tenant {
+        Tenant {
+            pool: self.clone(),
+            max_workers: max_workers,
+            active: sync::Arc::new(atomic::AtomicUsize::new(0)),
+        }
+    }
+}
+
+impl Tenant {
+    /// The number of workers of this tenant that have been started and have not yet exited.
+    pub fn active_workers(&self) -> usize {
+        self.active.load(atomic::Ordering::SeqCst)
+    }
+
+    fn spawn(&self, source: String) -> Result<(Channel, mpsc::Receiver<Event>), String> {
+        if self.active.fetch_add(1, atomic::Ordering::SeqCst) >= self.max_workers {
+            self.active.fetch_sub(1, atomic::Ordering::SeqCst);
+            return Err(format!("too many workers (at most {} may run at the same time)",
+                               self.max_workers));
+        }
+
+        let (command_sender, command_receiver) = mpsc::channel();
+        let (event_sender, event_receiver) = mpsc::channel();
+        let isolate = sync::Arc::new(sync::Mutex::new(None));
+        let terminated = sync::Arc::new(atomic::AtomicBool::new(false));
+
+        let job = Job {
+            source: source,
+            commands: command_receiver,
+            events: event_sender,
+            isolate: isolate.clone(),
+            terminated: terminated.clone(),
+            active: self.active.clone(),
+        };
+
+        if self.pool.jobs.lock().unwrap().send(job).is_err() {
+            self.active.fetch_sub(1, atomic::Ordering::SeqCst);
+            return Err("the worker pool has shut down".to_owned());
+        }
+
+        let channel = Channel {
+            commands: command_sender,
+            isolate: isolate,
+            terminated: terminated,
+        };
+
+        Ok((channel, event_receiver))
+    }
+}
+
+/// Defines the `Worker` constructor in the specified context, with workers taken from the
+/// specified tenant.
+///
+/// A running worker keeps its `Worker` object, and with it the context, alive until it exits or is
+/// terminated.
+pub fn install(isolate: &isolate::Isolate, context: &context::Context, tenant: &Tenant) {
+    context.set_slot(Host {
+        tenant: tenant.clone(),
+        workers: cell::RefCell::new(Vec::new()),
+    });
+
+    let constructor = value::Function::new(isolate, context, 1, Box::new(construct_worker));
+    let key = value::String::from_str(isolate, "Worker");
+    context.global().set(context, &key, &constructor);
+}
+
+/// Delivers the messages and errors that workers have sent to the specified context since the last
+/// call, by calling the `onmessage` and `onerror` handlers of their `Worker` objects.  Returns the
+/// number of delivered events.
+///
+/// Every event is delivered even if a handler throws; the first exception is returned afterwards.
+pub fn dispatch(isolate: &isolate::Isolate, context: &context::Context) -> error::Result<usize> {
+    let host = match context.slot::<Host>() {
+        Some(host) => host,
+        None => return Ok(0),
+    };
+
+    // Handlers may start or terminate workers, so they must not run while the list is borrowed
+    let mut pending = Vec::new();
+    {
+        let mut workers = host.workers.borrow_mut();
+        let mut exited = Vec::new();
+
+        for (index, worker) in workers.iter().enumerate() {
+            while let Ok(event) = worker.events.try_recv() {
+                match event {
+                    Event::Exit => {
+                        exited.push(index);
+                        break;
+                    }
+                    event => pending.push((worker.object.clone(), event)),
+                }
+            }
+        }
+
+        for index in exited.into_iter().rev() {
+            workers.remove(index);
+        }
+    }
+
+    let mut result = Ok(pending.len());
+
+    for (object, event) in pending {
+        let (handler, event) = match event {
+            Event::Message(envelope) => ("onmessage", message_event(isolate, context, envelope)),
+            Event::Error(message) => ("onerror", error_event(isolate, context, &message)),
+            Event::Exit => unreachable!(),
+        };
+
+        let delivered = call_handler(isolate, context, &object, handler, &event);
+
+        if result.is_ok() {
+            if let Err(error) = delivered {
+                result = Err(error);
+            }
+        }
+    }
+
+    result
+}
+
+fn construct_worker(info: value::FunctionCallbackInfo) -> Result<value::Value, value::Value> {
+    let isolate = info.isolate.clone();
+    let context = isolate.current_context().unwrap();
+
+    if !info.is_construct_call {
+        return Err(type_error(&isolate, "Worker must be called with new"));
+    }
+
+    let source = match info.args.get(0) {
+        Some(source) => source.to_string(&context).value(),
+        None => return Err(type_error(&isolate, "Worker needs the source of a script")),
+    };
+
+    let host = match context::Context::current_slot::<Host>(&isolate) {
+        Some(host) => host,
+        None => return Err(error(&isolate, "workers are not installed in this context")),
+    };
+
+    let (channel, events) = try!(host.tenant.spawn(source).map_err(|e| error(&isolate, &e)));
+    let channel = rc::Rc::new(channel);
+    let object = info.this;
+
+    let post_channel = channel.clone();
+    let post_message = value::Function::new(&isolate,
+                                            &context,
+                                            2,
+                                            Box::new(move |info| {
+        let isolate = info.isolate.clone();
+        let context = isolate.current_context().unwrap();
+        let envelope = try!(serialize(&isolate, &context, &info.args));
+        let _ = post_channel.commands.send(Command::Message(envelope));
+        Ok(value::undefined(&isolate).into())
+    }));
+    set_method(&isolate, &context, &object, "postMessage", &post_message);
+
+    let terminate = value::Function::new(&isolate,
+                                         &context,
+                                         0,
+                                         Box::new(move |info| {
+        let isolate = info.isolate.clone();
+        terminate_worker(&isolate, &info.this);
+        Ok(value::undefined(&isolate).into())
+    }));
+    set_method(&isolate, &context, &object, "terminate", &terminate);
+
+    host.workers.borrow_mut().push(Running {
+        object: object.clone(),
+        channel: channel,
+        events: events,
+    });
+
+    Ok(object.into())
+}
+
+fn terminate_worker(isolate: &isolate::Isolate, object: &value::Object) {
+    let host = match context::Context::current_slot::<Host>(isolate) {
+        Some(host) => host,
+        None => return,
+    };
+
+    let running = {
+        let mut workers = host.workers.borrow_mut();
+        match workers.iter().position(|w| w.object.strict_equals(object)) {
+            Some(index) => workers.remove(index),
+            None => return,
+        }
+    };
+
+    // A worker that is still queued sees the flag before it compiles its source
+    running.channel.terminated.store(true, atomic::Ordering::SeqCst);
+    let _ = running.channel.commands.send(Command::Terminate);
+
+    // The worker might be busy running a script, so it is interrupted as well
+    if let Some(ref worker_isolate) = *running.channel.isolate.lock().unwrap() {
+        unsafe { v8::v8_Isolate_TerminateExecution(worker_isolate.0) };
+    }
+}
+
+impl Job {
+    fn run(self) {
+        let _exit = JobExit {
+            events: self.events.clone(),
+            active: self.active.clone(),
+        };
+
+        if self.terminated.load(atomic::Ordering::SeqCst) {
+            return;
+        }
+
+        let isolate = isolate::Isolate::new();
+        let context = context::Context::new(&isolate);
+        let closing = rc::Rc::new(cell::Cell::new(false));
+        let _published = Published::new(&self.isolate, &isolate);
+
+        self.install_globals(&isolate, &context, &closing);
+
+        // A terminate() that came before the isolate was published did not interrupt it, so the
+        // flag is checked again before running any script
+        if self.terminated.load(atomic::Ordering::SeqCst) {
+            closing.set(true);
+        } else {
+            let source = value::String::from_str(&isolate, &self.source);
+            let started = script::Script::compile(&isolate, &context, &source)
+                .and_then(|script| script.run(&context));
+
+            if let Err(error) = started {
+                let _ = self.events.send(Event::Error(error_message(&error)));
+                closing.set(true);
+            }
+
+            isolate.run_enqueued_tasks();
+        }
+
+        while !closing.get() {
+            match self.commands.recv() {
+                Ok(Command::Message(envelope)) => {
+                    let event = message_event(&isolate, &context, envelope);
+                    let global = context.global();
+
+                    if let Err(error) =
+                           call_handler(&isolate, &context, &global, "onmessage", &event) {
+                        let _ = self.events.send(Event::Error(error_message(&error)));
+                    }
+                }
+                Ok(Command::Terminate) | Err(_) => break,
+            }
+
+            isolate.run_enqueued_tasks();
+        }
+    }
+
+    fn install_globals(&self,
+                       isolate: &isolate::Isolate,
+                       context: &context::Context,
+                       closing: &rc::Rc<cell::Cell<bool>>) {
+        let global = context.global();
+
+        let events = self.events.clone();
+        let post_message = value::Function::new(isolate,
+                                                context,
+                                                2,
+                                                Box::new(move |info| {
+            let isolate = info.isolate.clone();
+            let context = isolate.current_context().unwrap();
+            let envelope = try!(serialize(&isolate, &context, &info.args));
+            let _ = events.send(Event::Message(envelope));
+            Ok(value::undefined(&isolate).into())
+        }));
+        set_method(isolate, context, &global, "postMessage", &post_message);
+
+        let closing = closing.clone();
+        let close = value::Function::new(isolate,
+                                         context,
+                                         0,
+                                         Box::new(move |info| {
+            closing.set(true);
+            Ok(value::undefined(&info.isolate).into())
+        }));
+        set_method(isolate, context, &global, "close", &close);
+    }
+}
+
+impl Drop for JobExit {
+    fn drop(&mut self) {
+        if thread::panicking() {
+            let _ = self.events.send(Event::Error("the worker panicked".to_owned()));
+        }
+
+        self.active.fetch_sub(1, atomic::Ordering::SeqCst);
+        let _ = self.events.send(Event::Exit);
+    }
+}
+
+impl<'a> Published<'a> {
+    fn new(slot: &'a sync::Mutex<Option<IsolatePtr>>,
+           isolate: &isolate::Isolate)
+           -> Published<'a> {
+        *slot.lock().unwrap() = Some(IsolatePtr(isolate.as_raw()));
+        Published(slot)
+    }
+}
+
+impl<'a> Drop for Published<'a> {
+    fn drop(&mut self) {
+        // Declared after the isolate, so this runs before the isolate is disposed
+        *self.0.lock().unwrap_or_else(|e| e.into_inner()) = None;
+    }
+}
+
+/// Clones the arguments of a `postMessage` call, detaching the transferred array buffers.
+fn serialize(isolate: &isolate::Isolate,
+             context: &context::Context,
+             args: &[value::Value])
+             -> Result<Envelope, value::Value> {
+    let undefined: value::Value = value::undefined(isolate).into();
+    let message = args.get(0).unwrap_or(&undefined);
+
+    let mut transfer = Vec::new();
+    if let Some(list) = args.get(1) {
+        if !list.is_undefined() {
+            let list = match list.clone().into_array() {
+                Some(list) => list,
+                None => return Err(type_error(isolate, "the transfer list must be an array")),
+            };
+
+            // Nothing is detached until the whole list has been checked, so that a rejected
+            // message leaves all of its buffers intact
+            for item in list.iter(context) {
+                let item = try!(item.map_err(|e| error(isolate, &error_message(&e))));
+                let buffer = match item.into_array_buffer() {
+                    Some(buffer) => buffer,
+                    None => {
+                        return Err(type_error(isolate,
+                                              "only ArrayBuffers can be transferred"))
+                    }
+                };
+
+                if transfer.iter().any(|t: &value::ArrayBuffer| t.strict_equals(&buffer)) {
+                    return Err(type_error(isolate,
+                                          "an ArrayBuffer is listed more than once for transfer"));
+                }
+
+                if !buffer.is_detachable() {
+                    return Err(type_error(isolate, "an ArrayBuffer could not be transferred"));
+                }
+
+                transfer.push(buffer);
+            }
+        }
+    }
+
+    let mut memo = object_map::JsObjectMap::new(isolate);
+    let message = try!(clone_value(isolate, context, message, &transfer, &mut memo, 0)
+        .map_err(|e| error(isolate, &format!("could not clone message: {}", e))));
+
+    let mut transferred = Vec::with_capacity(transfer.len());
+    for buffer in &transfer {
+        match buffer.detach() {
+            Some(bytes) => transferred.push(bytes),
+            None => return Err(type_error(isolate, "an ArrayBuffer could not be transferred")),
+        }
+    }
+
+    Ok(Envelope {
+        message: message,
+        transferred: transferred,
+    })
+}
+
+/// Clones a value into a message.
+///
+/// `memo` maps the objects that have been cloned so far to their index in the order in which they
+/// were first reached, so that later occurrences become references to the first clone.
+fn clone_value(isolate: &isolate::Isolate,
+               context: &context::Context,
+               value: &value::Value,
+               transfer: &[value::ArrayBuffer],
+               memo: &mut object_map::JsObjectMap<usize>,
+               depth: usize)
+               -> Result<Message, String> {
+    if depth > MAX_DEPTH {
+        return Err("the message is nested too deeply".to_owned());
+    }
+
+    if let Some(object) = value.clone().into_object() {
+        if let Some(&index) = memo.get(&object) {
+            return Ok(Message::Reference(index));
+        }
+    }
+
+    if value.is_undefined() {
+        Ok(Message::Undefined)
+    } else if value.is_null() {
+        Ok(Message::Null)
+    } else if value.is_boolean() {
+        Ok(Message::Boolean(value.boolean_value(context)))
+    } else if value.is_number() {
+        Ok(Message::Number(value.number_value(context)))
+    } else if value.is_string() {
+        Ok(Message::String(value.to_string(context).value()))
+    } else if value.is_array_buffer() {
+        let buffer = value.clone().into_array_buffer().unwrap();
+
+        match transfer.iter().position(|t| t.strict_equals(&buffer)) {
+            Some(index) => Ok(Message::Transferred(index)),
+            None => {
+                memorize(memo, value);
+                let (data, length) = unsafe { buffer.contents() };
+                let bytes = if length == 0 {
+                    Vec::new()
+                } else {
+                    unsafe { ::std::slice::from_raw_parts(data, length) }.to_vec()
+                };
+                Ok(Message::ArrayBuffer(bytes))
+            }
+        }
+    } else if value.is_array() {
+        let array = value.clone().into_array().unwrap();
+        let mut items = Vec::with_capacity(array.length() as usize);
+        memorize(memo, value);
+
+        for item in array.iter(context) {
+            let item = try!(item.map_err(|e| error_message(&e)));
+            items.push(try!(clone_value(isolate, context, &item, transfer, memo, depth + 1)));
+        }
+
+        Ok(Message::Array(items))
+    } else if value.is_function() || value.is_symbol() {
+        Err("functions and symbols can't be cloned".to_owned())
+    } else if let Some(object) = value.clone().into_object() {
+        let names = object.get_own_property_names(context);
+        let mut properties = Vec::with_capacity(names.length() as usize);
+        memorize(memo, value);
+
+        for name in names.iter(context) {
+            let name = try!(name.map_err(|e| error_message(&e)));
+            let property = object.get(context, &name);
+            let property =
+                try!(clone_value(isolate, context, &property, transfer, memo, depth + 1));
+            properties.push((name.to_string(context).value(), property));
+        }
+
+        Ok(Message::Object(properties))
+    } else {
+        Err("the value has an unsupported type".to_owned())
+    }
+}
+
+/// Gives the next index to an object that is about to be cloned.
+fn memorize(memo: &mut object_map::JsObjectMap<usize>, value: &value::Value) {
+    let index = memo.len();
+    memo.insert(&value.clone().into_object().unwrap(), index);
+}
+
+fn deserialize(isolate: &isolate::Isolate,
+               context: &context::Context,
+               envelope: Envelope)
+               -> value::Value {
+    let mut transferred = envelope.transferred.into_iter().map(Some).collect::<Vec<_>>();
+    let mut buffers = collections::HashMap::new();
+    let mut objects = Vec::new();
+
+    build_value(isolate,
+                context,
+                envelope.message,
+                &mut transferred,
+                &mut buffers,
+                &mut objects)
+}
+
+/// Builds the value of a message.
+///
+/// `objects` collects the objects that have been built so far, in the same order as `memo` in
+/// `clone_value`, to resolve references.
+fn build_value(isolate: &isolate::Isolate,
+               context: &context::Context,
+               message: Message,
+               transferred: &mut Vec<Option<Vec<u8>>>,
+               buffers: &mut collections::HashMap<usize, value::ArrayBuffer>,
+               objects: &mut Vec<value::Value>)
+               -> value::Value {
+    match message {
+        Message::Undefined => value::undefined(isolate).into(),
+        Message::Null => value::null(isolate).into(),
+        Message::Boolean(b) => value::Boolean::new(isolate, b).into(),
+        Message::Number(n) => value::Number::new(isolate, n).into(),
+        Message::String(s) => value::String::from_str(isolate, &s).into(),
+        Message::ArrayBuffer(bytes) => {
+            let buffer: value::Value = value::ArrayBuffer::from_vec(isolate, bytes).into();
+            objects.push(buffer.clone());
+            buffer
+        }
+        Message::Reference(index) => objects[index].clone(),
+        Message::Transferred(index) => {
+            // A buffer that occurs several times in the message becomes a single buffer
+            if let Some(bytes) = transferred[index].take() {
+                buffers.insert(index, value::ArrayBuffer::from_vec(isolate, bytes));
+            }
+            buffers[&index].clone().into()
+        }
+        Message::Array(items) => {
+            let array = value::Array::new(isolate, context, items.len() as u32);
+            objects.push(array.clone().into());
+            for (index, item) in items.into_iter().enumerate() {
+                let item = build_value(isolate, context, item, transferred, buffers, objects);
+                array.set_index(context, index as u32, &item);
+            }
+            array.into()
+        }
+        Message::Object(properties) => {
+            let object = value::Object::new(isolate, context);
+            objects.push(object.clone().into());
+            for (name, property) in properties {
+                let key = value::String::from_str(isolate, &name);
+                let property = build_value(isolate,
+                                           context,
+                                           property,
+                                           transferred,
+                                           buffers,
+                                           objects);
+                object.set(context, &key, &property);
+            }
+            object.into()
+        }
+    }
+}
+
+fn message_event(isolate: &isolate::Isolate,
+                 context: &context::Context,
+                 envelope: Envelope)
+                 -> value::Value {
+    let event = value::Object::new(isolate, context);
+    let key = value::String::from_str(isolate, "data");
+    event.set(context, &key, &deserialize(isolate, context, envelope));
+    event.into()
+}
+
+fn error_event(isolate: &isolate::Isolate, context: &context::Context, message: &str) -> value::Value {
+    let event = value::Object::new(isolate, context);
+    let key = value::String::from_str(isolate, "message");
+    event.set(context, &key, &value::String::from_str(isolate, message));
+    event.into()
+}
+
+fn call_handler(isolate: &isolate::Isolate,
+                context: &context::Context,
+                target: &value::Object,
+                name: &str,
+                event: &value::Value)
+                -> error::Result<()> {
+    let key = value::String::from_str(isolate, name);
+
+    match target.get(context, &key).into_function() {
+        Some(handler) => {
+            try!(handler.call_with_this(context, target, &[event]));
+            Ok(())
+        }
+        None => Ok(()),
+    }
+}
+
+fn set_method(isolate: &isolate::Isolate,
+              context: &context::Context,
+              object: &value::Object,
+              name: &str,
+              function: &value::Function) {
+    let key = value::String::from_str(isolate, name);
+    object.set(context, &key, function);
+}
+
+fn error_message(error: &error::Error) -> String {
+    match *error.kind() {
+        error::ErrorKind::Javascript(ref exception) => exception.message(),
+        _ => error.to_string(),
+    }
+}
+
+fn error(isolate: &isolate::Isolate, message: &str) -> value::Value {
+    value::Exception::error(isolate, &value::String::from_str(isolate, message))
+}
+
+fn type_error(isolate: &isolate::Isolate, message: &str) -> value::Value {
+    value::Exception::type_error(isolate, &value::String::from_str(isolate, message))
+}
@@ -0,0 +1,48 @@
+//! Pinning isolate threads under a configured affinity policy.
+//!
+//! The policy is process-wide and also picked up by worker pools, so this runs in its own test
+//! binary rather than next to the unit tests.
+extern crate v8;
+
+use std::sync::mpsc;
+use std::thread;
+use v8::affinity;
+use v8::clock;
+use v8::value;
+
+#[test]
+fn pinned_isolate_thread() {
+    let topology = affinity::Topology::detect();
+    assert!(topology.cpu_count() > 0);
+    let node = topology.nodes()[0].id();
+    affinity::configure(affinity::Policy::new(topology));
+
+    thread::spawn(move || {
+            affinity::pin_to_node(node).unwrap();
+            assert_eq!(Some(node), affinity::current_node());
+
+            // Background tasks of this isolate now go to the pool of the node
+            let isolate = v8::Isolate::new();
+            let context = v8::Context::new(&isolate);
+            let source = value::String::from_str(&isolate,
+                                                 "var a = []; for (var i = 0; i < 1e5; i++) \
+                                                  a.push({ i: i }); a.length");
+            let script = v8::Script::compile(&isolate, &context, &source).unwrap();
+            let length = script.run(&context).unwrap();
+            assert_eq!(100000, length.int32_value(&context));
+            isolate.run_enqueued_tasks();
+
+            // A task posted from this thread runs on a thread of the pool of the node
+            let (sender, receiver) = mpsc::channel();
+            clock::post_background_task(Box::new(move || {
+                let name = thread::current().name().map(|name| name.to_owned());
+                let _ = sender.send((affinity::current_node(), name));
+            }));
+
+            let (ran_on, name) = receiver.recv().unwrap();
+            assert_eq!(Some(node), ran_on);
+            assert_eq!(Some(format!("v8 node {} background", node)), name);
+        })
+        .join()
+        .unwrap();
+}
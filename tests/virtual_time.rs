@@ -0,0 +1,80 @@
+//! Virtual time with queued background tasks.
+//!
+//! Virtual time has to be enabled before the first isolate is created, so this runs in its own
+//! test binary, as a single test.
+extern crate v8;
+
+use std::sync;
+use std::time;
+use v8::clock;
+
+type Log = sync::Arc<sync::Mutex<Vec<&'static str>>>;
+
+/// A task that appends the specified name to the log.
+fn record(log: &Log, name: &'static str) -> Box<FnMut() + Send> {
+    let log = log.clone();
+    Box::new(move || log.lock().unwrap().push(name))
+}
+
+#[test]
+fn queued_virtual_time() {
+    clock::use_virtual_time(clock::BackgroundTasks::Queued).unwrap();
+    assert!(clock::is_virtual());
+    assert_eq!(time::Duration::new(0, 0), clock::now());
+
+    let isolate = v8::Isolate::new();
+    assert!(clock::use_virtual_time(clock::BackgroundTasks::Inline).is_err());
+
+    // Delayed foreground tasks only become due as the clock is advanced
+    let log = Log::default();
+    isolate.post_task(time::Duration::from_millis(20), record(&log, "late"));
+    isolate.post_task(time::Duration::from_millis(10), record(&log, "soon"));
+    isolate.post_task(time::Duration::new(0, 0), record(&log, "now"));
+
+    isolate.run_enqueued_tasks();
+    assert_eq!(vec!["now"], *log.lock().unwrap());
+
+    clock::advance(time::Duration::from_millis(10)).unwrap();
+    assert_eq!(time::Duration::from_millis(10), clock::now());
+    isolate.run_enqueued_tasks();
+    assert_eq!(vec!["now", "soon"], *log.lock().unwrap());
+
+    clock::advance(time::Duration::from_millis(5)).unwrap();
+    isolate.run_enqueued_tasks();
+    assert_eq!(vec!["now", "soon"], *log.lock().unwrap());
+
+    clock::advance(time::Duration::from_millis(5)).unwrap();
+    isolate.run_enqueued_tasks();
+    assert_eq!(vec!["now", "soon", "late"], *log.lock().unwrap());
+
+    // Tasks that become due at the same time run in the order they were posted
+    let log = Log::default();
+    for name in &["a", "b", "c", "d"] {
+        isolate.post_task(time::Duration::from_millis(1), record(&log, *name));
+    }
+
+    clock::advance(time::Duration::from_millis(1)).unwrap();
+    isolate.run_enqueued_tasks();
+    assert_eq!(vec!["a", "b", "c", "d"], *log.lock().unwrap());
+
+    // Background tasks wait in the queue, and run in the order they were posted, including tasks
+    // that are posted while the queue runs
+    let log = Log::default();
+    let mut nested = Some(record(&log, "nested"));
+    let mut first = record(&log, "first");
+    clock::post_background_task(Box::new(move || {
+        first();
+        if let Some(nested) = nested.take() {
+            clock::post_background_task(nested);
+        }
+    }));
+    clock::post_background_task(record(&log, "second"));
+    clock::post_background_task(record(&log, "third"));
+
+    assert!(clock::pending_background_tasks() >= 3);
+    assert!(log.lock().unwrap().is_empty());
+
+    assert!(clock::run_background_tasks() >= 4);
+    assert_eq!(0, clock::pending_background_tasks());
+    assert_eq!(vec!["first", "second", "third", "nested"], *log.lock().unwrap());
+}
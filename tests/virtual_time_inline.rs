@@ -0,0 +1,39 @@
+//! Virtual time with inline background tasks.
+//!
+//! Virtual time has to be enabled before the first isolate is created, so this runs in its own
+//! test binary, as a single test.
+extern crate v8;
+
+use std::sync;
+use std::time;
+use v8::clock;
+
+#[test]
+fn inline_virtual_time() {
+    clock::use_virtual_time(clock::BackgroundTasks::Inline).unwrap();
+    let isolate = v8::Isolate::new();
+
+    // Background tasks run on the posting thread before the post returns, so a task posted from
+    // another task runs within it
+    let log = sync::Arc::new(sync::Mutex::new(Vec::new()));
+    let outer_log = log.clone();
+    let inner_log = log.clone();
+
+    clock::post_background_task(Box::new(move || {
+        outer_log.lock().unwrap().push("outer");
+        let inner_log = inner_log.clone();
+        clock::post_background_task(Box::new(move || inner_log.lock().unwrap().push("inner")));
+        outer_log.lock().unwrap().push("outer done");
+    }));
+
+    assert_eq!(vec!["outer", "inner", "outer done"], *log.lock().unwrap());
+    assert_eq!(0, clock::pending_background_tasks());
+    assert_eq!(0, clock::run_background_tasks());
+
+    // Time stands still until it is advanced, whatever the wall clock does
+    let before = clock::now();
+    isolate.run_enqueued_tasks();
+    assert_eq!(before, clock::now());
+    clock::advance(time::Duration::from_secs(1)).unwrap();
+    assert_eq!(before + time::Duration::from_secs(1), clock::now());
+}
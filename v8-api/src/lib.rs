@@ -170,6 +170,7 @@ const SPECIAL_CLASSES: &'static [&'static str] = &[
 #[cfg_attr(rustfmt, rustfmt_skip)]
 const SPECIAL_METHODS: &'static [(&'static str, &'static str)] = &[
     ("Script", "Compile"), // Because ScriptOrigin param
+    ("ScriptCompiler", "CompileFunctionInContext"), // Because annoying-to-map signature
     ("Message", "GetScriptOrigin"), // Because ScriptOrigin
     ("String", "WriteUtf8"), // Because annoying-to-map signature
     ("Object", "SetAlignedPointerInInternalFields"), // Because annoying-to-map signature
@@ -177,6 +178,7 @@ const SPECIAL_METHODS: &'static [(&'static str, &'static str)] = &[
     ("Object", "CallAsConstructor"), // Because annoying-to-map signature
     ("Object", "NewInstance"), // Because annoying-to-map signature
     ("Object", "Call"), // Because annoying-to-map signature
+    ("Object", "SetAccessor"), // Because annoying-to-map signature
     ("Function", "New"), // Because annoying-to-map signature
     ("Function", "GetScriptOrigin"), // Because ScriptOrigin
     ("Function", "NewInstance"), // Because annoying-to-map signature
@@ -201,6 +203,7 @@ const SPECIAL_METHODS: &'static [(&'static str, &'static str)] = &[
     ("V8", "Dispose"), // V8::Dispose takes no context
     ("V8", "InitializePlatform"), // V8::InitializePlatform takes no context
     ("V8", "ShutdownPlatform"), // V8::ShutdownPlatform takes no context
+    ("V8", "SetFlagsFromString"), // V8::SetFlagsFromString takes no context
 ];
 
 /// Default mangle rules.
@@ -319,7 +319,7 @@ fn write_cc_file<W>(api: &v8_api::Api, mut out: W) -> io::Result<()>
             }
             try!(writeln!(out, ") {{"));
 
-            try!(writeln!(out, "  v8::Isolate::Scope __isolate_scope(c.isolate);"));
+            try!(writeln!(out, "  IsolateScope __isolate_scope(c);"));
             try!(writeln!(out, "  v8::HandleScope __handle_scope(c.isolate);"));
             try!(writeln!(out, "  v8::TryCatch __try_catch(c.isolate);"));
 
@@ -327,12 +327,7 @@ fn write_cc_file<W>(api: &v8_api::Api, mut out: W) -> io::Result<()>
                 .to_owned())));
             if let Some(arg) = method.args.iter().find(|ref a| a.arg_type == context_type) {
                 // There should only be one context but who knows
-                try!(writeln!(out,
-                              "  auto wrapped_{ctx} = wrap(c.isolate, {ctx});",
-                              ctx = arg.name));
-                try!(writeln!(out,
-                              "  v8::Context::Scope {ctx}_scope(wrapped_{ctx});",
-                              ctx = arg.name));
+                try!(writeln!(out, "  ContextScope {ctx}_scope(c, {ctx});", ctx = arg.name));
             }
 
             for arg in method.args.iter() {
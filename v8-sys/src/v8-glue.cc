@@ -2,7 +2,17 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <utility>
 
+/* The isolate data slot of the glue's own per-isolate state; slot 0
+   belongs to the Rust side.
+*/
+const uint32_t GLUE_DATA_SLOT = 1;
+
+struct GlueIsolateData {
+    v8::Eternal<v8::ObjectTemplate> accessor_data_template;
+};
 
 template<typename A> v8::Persistent<A> *unwrap(v8::Isolate *isolate,
                                                v8::Local<A> value)
@@ -271,11 +281,147 @@ PropertyCallbackInfo build_callback_info(
         nullptr,
         info.ShouldThrowOnError(),
         nullptr,
+        PrimitiveReturnValue_None,
+        0.0,
     };
 
     return result;
 }
 
+/* Hands the result of a property callback over to V8.  Primitive
+   results are set directly on the return value, so that they don't
+   need a handle to be allocated on the Rust side.
+*/
+void set_property_callback_result(
+    v8::Isolate *isolate,
+    const v8::PropertyCallbackInfo<v8::Value> &info,
+    PropertyCallbackInfo &callback_info) {
+
+    if (callback_info.ThrownValue) {
+        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
+        callback_info.ThrownValue->Reset();
+        delete callback_info.ThrownValue;
+        return;
+    }
+
+    v8::ReturnValue<v8::Value> return_value = info.GetReturnValue();
+
+    switch (callback_info.ReturnPrimitive) {
+    case PrimitiveReturnValue_Undefined:
+        return_value.SetUndefined();
+        break;
+    case PrimitiveReturnValue_Null:
+        return_value.SetNull();
+        break;
+    case PrimitiveReturnValue_Boolean:
+        return_value.Set(callback_info.ReturnNumber != 0.0);
+        break;
+    case PrimitiveReturnValue_Int32:
+        return_value.Set((int32_t) callback_info.ReturnNumber);
+        break;
+    case PrimitiveReturnValue_Uint32:
+        return_value.Set((uint32_t) callback_info.ReturnNumber);
+        break;
+    case PrimitiveReturnValue_Number:
+        return_value.Set(callback_info.ReturnNumber);
+        break;
+    default:
+    case PrimitiveReturnValue_None:
+        if (callback_info.ReturnValue) {
+            return_value.Set(wrap(isolate, callback_info.ReturnValue));
+            callback_info.ReturnValue->Reset();
+            delete callback_info.ReturnValue;
+        }
+        break;
+    }
+}
+
+void set_property_callback_result(
+    v8::Isolate *isolate,
+    const v8::PropertyCallbackInfo<void> &info,
+    PropertyCallbackInfo &callback_info) {
+
+    if (callback_info.ThrownValue) {
+        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
+        callback_info.ThrownValue->Reset();
+        delete callback_info.ThrownValue;
+    }
+}
+
+void set_property_callback_result(
+    v8::Isolate *isolate,
+    const v8::PropertyCallbackInfo<v8::Integer> &info,
+    PropertyCallbackInfo &callback_info) {
+
+    if (callback_info.ThrownValue) {
+        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
+        callback_info.ThrownValue->Reset();
+        delete callback_info.ThrownValue;
+        return;
+    }
+
+    switch (callback_info.ReturnPrimitive) {
+    case PrimitiveReturnValue_Int32:
+        info.GetReturnValue().Set((int32_t) callback_info.ReturnNumber);
+        break;
+    case PrimitiveReturnValue_Uint32:
+        info.GetReturnValue().Set((uint32_t) callback_info.ReturnNumber);
+        break;
+    default:
+        if (callback_info.ReturnValue) {
+            info.GetReturnValue().Set(v8::Local<v8::Integer>::Cast(wrap(isolate, callback_info.ReturnValue)));
+            callback_info.ReturnValue->Reset();
+            delete callback_info.ReturnValue;
+        }
+        break;
+    }
+}
+
+void set_property_callback_result(
+    v8::Isolate *isolate,
+    const v8::PropertyCallbackInfo<v8::Boolean> &info,
+    PropertyCallbackInfo &callback_info) {
+
+    if (callback_info.ThrownValue) {
+        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
+        callback_info.ThrownValue->Reset();
+        delete callback_info.ThrownValue;
+        return;
+    }
+
+    switch (callback_info.ReturnPrimitive) {
+    case PrimitiveReturnValue_Boolean:
+        info.GetReturnValue().Set(callback_info.ReturnNumber != 0.0);
+        break;
+    default:
+        if (callback_info.ReturnValue) {
+            info.GetReturnValue().Set(v8::Local<v8::Boolean>::Cast(wrap(isolate, callback_info.ReturnValue)));
+            callback_info.ReturnValue->Reset();
+            delete callback_info.ReturnValue;
+        }
+        break;
+    }
+}
+
+void set_property_callback_result(
+    v8::Isolate *isolate,
+    const v8::PropertyCallbackInfo<v8::Array> &info,
+    PropertyCallbackInfo &callback_info) {
+
+    if (callback_info.ThrownValue) {
+        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
+        callback_info.ThrownValue->Reset();
+        delete callback_info.ThrownValue;
+        return;
+    }
+
+    if (callback_info.ReturnValue) {
+        info.GetReturnValue().Set(v8::Local<v8::Array>::Cast(wrap(isolate, callback_info.ReturnValue)));
+        callback_info.ReturnValue->Reset();
+        delete callback_info.ReturnValue;
+    }
+}
+
 template<typename A>
 FunctionCallbackInfo build_callback_info(
     const v8::FunctionCallbackInfo<A> &info,
@@ -328,11 +474,7 @@ void generic_named_property_handler_getter(
 
     getter(unwrap(isolate, property), &callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(wrap(isolate, callback_info.ReturnValue));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 void generic_named_property_handler_setter(
@@ -352,11 +494,7 @@ void generic_named_property_handler_setter(
 
     setter(unwrap(isolate, property), unwrap(isolate, value), &callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(wrap(isolate, callback_info.ReturnValue));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 void generic_named_property_handler_query(
@@ -375,11 +513,7 @@ void generic_named_property_handler_query(
 
     query(unwrap(isolate, property), &callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(v8::Local<v8::Integer>::Cast(wrap(isolate, callback_info.ReturnValue)));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 void generic_named_property_handler_deleter(
@@ -398,11 +532,7 @@ void generic_named_property_handler_deleter(
 
     deleter(unwrap(isolate, property), &callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(v8::Local<v8::Boolean>::Cast(wrap(isolate, callback_info.ReturnValue)));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 void generic_named_property_handler_enumerator(
@@ -420,11 +550,7 @@ void generic_named_property_handler_enumerator(
 
     enumerator(&callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(v8::Local<v8::Array>::Cast(wrap(isolate, callback_info.ReturnValue)));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 v8::NamedPropertyHandlerConfiguration wrap(
@@ -504,11 +630,7 @@ void indexed_property_handler_getter(
 
     getter(index, &callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(wrap(isolate, callback_info.ReturnValue));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 void indexed_property_handler_setter(
@@ -528,11 +650,7 @@ void indexed_property_handler_setter(
 
     setter(index, unwrap(isolate, value), &callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(wrap(isolate, callback_info.ReturnValue));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 void indexed_property_handler_query(
@@ -551,11 +669,7 @@ void indexed_property_handler_query(
 
     query(index, &callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(v8::Local<v8::Integer>::Cast(wrap(isolate, callback_info.ReturnValue)));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 void indexed_property_handler_deleter(
@@ -574,11 +688,7 @@ void indexed_property_handler_deleter(
 
     deleter(index, &callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(v8::Local<v8::Boolean>::Cast(wrap(isolate, callback_info.ReturnValue)));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 void indexed_property_handler_enumerator(
@@ -596,11 +706,7 @@ void indexed_property_handler_enumerator(
 
     enumerator(&callback_info);
 
-    if (callback_info.ThrownValue) {
-        isolate->ThrowException(wrap(isolate, callback_info.ThrownValue));
-    } else if (callback_info.ReturnValue) {
-        info.GetReturnValue().Set(v8::Local<v8::Array>::Cast(wrap(isolate, callback_info.ReturnValue)));
-    }
+    set_property_callback_result(isolate, info, callback_info);
 }
 
 v8::IndexedPropertyHandlerConfiguration wrap(
@@ -675,6 +781,54 @@ void handle_exception(RustContext &c, v8::TryCatch &try_catch) {
     }
 }
 
+/* Enters the isolate of a call for the duration of the scope, unless
+   the caller has already entered it.
+*/
+class IsolateScope {
+public:
+    IsolateScope(const RustContext &c)
+        : _isolate(c.isolate_entered ? nullptr : c.isolate)
+    {
+        if (_isolate) {
+            _isolate->Enter();
+        }
+    }
+
+    ~IsolateScope() {
+        if (_isolate) {
+            _isolate->Exit();
+        }
+    }
+
+private:
+    v8::Isolate *_isolate;
+};
+
+/* Enters the context of a call for the duration of the scope.  When
+   the caller may have entered a context already, the isolate's current
+   context is checked first, and entering is skipped if it is the
+   context of the call.
+*/
+class ContextScope {
+public:
+    ContextScope(const RustContext &c, ContextRef context)
+    {
+        if (!c.context_entered) {
+            _context = wrap(c.isolate, context);
+            _context->Enter();
+        }
+    }
+
+    ~ContextScope() {
+        if (!_context.IsEmpty()) {
+            _context->Exit();
+        }
+    }
+
+private:
+    v8::Local<v8::Context> _context;
+};
+
 class GluePlatform : public v8::Platform {
 public:
     GluePlatform(v8_PlatformFunctions platform_functions)
@@ -753,6 +907,28 @@ private:
     v8_AllocatorFunctions _allocator_functions;
 };
 
+/* A task whose work is a Rust closure, which is freed with the task.
+*/
+class RustTask : public v8::Task {
+public:
+    RustTask(TaskCallback run, TaskCallback destroy, void *data)
+        : _run(run), _destroy(destroy), _data(data)
+    {}
+
+    virtual ~RustTask() {
+        _destroy(_data);
+    }
+
+    virtual void Run() {
+        _run(_data);
+    }
+
+private:
+    TaskCallback _run;
+    TaskCallback _destroy;
+    void *_data;
+};
+
 PlatformPtr v8_Platform_Create(struct v8_PlatformFunctions platform_functions) {
     return new GluePlatform(platform_functions);
 }
@@ -761,6 +937,10 @@ void v8_Platform_Destroy(PlatformPtr platform) {
     delete platform;
 }
 
+TaskPtr v8_Task_New(TaskCallback run, TaskCallback destroy, void *data) {
+    return new RustTask(run, destroy, data);
+}
+
 void v8_Task_Destroy(TaskPtr task) {
     delete task;
 }
@@ -789,6 +969,10 @@ void v8_V8_ShutdownPlatform() {
     v8::V8::ShutdownPlatform();
 }
 
+void v8_V8_SetFlagsFromString(const char *flags, int length) {
+    v8::V8::SetFlagsFromString(flags, length);
+}
+
 
 ArrayBuffer_AllocatorPtr v8_ArrayBuffer_Allocator_Create(struct v8_AllocatorFunctions allocator_functions) {
     return new GlueAllocator(allocator_functions);
@@ -832,7 +1016,41 @@ void v8_Isolate_SetCaptureStackTraceForUncaughtExceptions_Detailed(IsolatePtr se
     self->SetCaptureStackTraceForUncaughtExceptions(capture, frame_limit, v8::StackTrace::kDetailed);
 }
 
+int64_t v8_Isolate_AdjustAmountOfExternalAllocatedMemory(IsolatePtr self, int64_t change_in_bytes) {
+    return self->AdjustAmountOfExternalAllocatedMemory(change_in_bytes);
+}
+
+void v8_Isolate_LowMemoryNotification(IsolatePtr self) {
+    v8::Isolate::Scope isolate_scope(self);
+    self->LowMemoryNotification();
+}
+
+void v8_Isolate_Enter(IsolatePtr self) {
+    self->Enter();
+}
+
+void v8_Isolate_Exit(IsolatePtr self) {
+    self->Exit();
+}
+
+void v8_Isolate_TerminateExecution(IsolatePtr self) {
+    self->TerminateExecution();
+}
+
+void *v8_Isolate_GetCurrentContextAlignedPointer(IsolatePtr self, int index) {
+    v8::Isolate::Scope isolate_scope(self);
+    v8::HandleScope scope(self);
+    auto context = self->GetCurrentContext();
+
+    if (context.IsEmpty()) {
+        return nullptr;
+    }
+
+    return context->GetAlignedPointerFromEmbedderData(index);
+}
+
 void v8_Isolate_Dispose(IsolatePtr isolate) {
+    delete (GlueIsolateData *) isolate->GetData(GLUE_DATA_SLOT);
     isolate->Dispose();
 }
 
@@ -844,10 +1062,16 @@ void v8_IdleTask_Run(IdleTaskPtr task, double deadline_in_seconds) {
     task->Run(deadline_in_seconds);
 }
 
+void v8_Smi_Layout(int *tag, int *tag_size, int *shift_size) {
+    *tag = v8::internal::kSmiTag;
+    *tag_size = v8::internal::kSmiTagSize;
+    *shift_size = v8::internal::kSmiShiftSize;
+}
+
 #include "v8-glue-generated.cc"
 
 PrimitiveRef v8_Undefined(RustContext c) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     auto result = v8::Undefined(c.isolate);
@@ -856,7 +1080,7 @@ PrimitiveRef v8_Undefined(RustContext c) {
 }
 
 PrimitiveRef v8_Null(RustContext c) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     auto result = v8::Null(c.isolate);
@@ -865,7 +1089,7 @@ PrimitiveRef v8_Null(RustContext c) {
 }
 
 BooleanRef v8_True(RustContext c) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     auto result = v8::True(c.isolate);
@@ -874,7 +1098,7 @@ BooleanRef v8_True(RustContext c) {
 }
 
 BooleanRef v8_False(RustContext c) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     auto result = v8::False(c.isolate);
@@ -883,7 +1107,7 @@ BooleanRef v8_False(RustContext c) {
 }
 
 ContextRef v8_Context_New(RustContext c) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     auto result = v8::Context::New(c.isolate);
@@ -891,8 +1115,17 @@ ContextRef v8_Context_New(RustContext c) {
     return unwrap(c.isolate, result);
 }
 
+ContextRef v8_Context_New_GlobalTemplate(RustContext c, ObjectTemplateRef global_template) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::TryCatch try_catch(c.isolate);
+    auto result = v8::Context::New(c.isolate, nullptr, wrap(c.isolate, global_template));
+    handle_exception(c, try_catch);
+    return unwrap(c.isolate, result);
+}
+
 StringRef v8_String_NewFromUtf8_Normal(RustContext c, const char *data, int length) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     auto result = v8::String::NewFromUtf8(c.isolate, data, v8::NewStringType::kNormal, length);
@@ -901,7 +1134,7 @@ StringRef v8_String_NewFromUtf8_Normal(RustContext c, const char *data, int leng
 }
 
 StringRef v8_String_NewFromUtf8_Internalized(RustContext c, const char *data, int length) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     auto result = v8::String::NewFromUtf8(c.isolate, data, v8::NewStringType::kInternalized, length);
@@ -910,7 +1143,7 @@ StringRef v8_String_NewFromUtf8_Internalized(RustContext c, const char *data, in
 }
 
 int v8_String_WriteUtf8(RustContext c, StringRef string, char *buffer, int length) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     auto result = wrap(c.isolate, string)->WriteUtf8(buffer, length);
@@ -919,10 +1152,10 @@ int v8_String_WriteUtf8(RustContext c, StringRef string, char *buffer, int lengt
 }
 
 ScriptRef v8_Script_Compile(RustContext c, ContextRef context, StringRef source) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
-    v8::Context::Scope context_scope(wrap(c.isolate, context));
+    ContextScope context_scope(c, context);
     auto result = v8::Script::Compile(wrap(c.isolate, context), wrap(c.isolate, source));
     handle_exception(c, try_catch);
     return unwrap(c.isolate, result);
@@ -941,10 +1174,10 @@ ScriptRef v8_Script_Compile_Origin(
     BooleanRef resource_is_embedder_debug_script,
     ValueRef source_map_url,
     BooleanRef resource_is_opaque) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
-    v8::Context::Scope context_scope(wrap(c.isolate, context));
+    ContextScope context_scope(c, context);
 
     v8::ScriptOrigin origin(
         wrap(c.isolate, resource_name),
@@ -967,11 +1200,28 @@ ScriptRef v8_Script_Compile_Origin(
     return unwrap(c.isolate, result);
 }
 
+FunctionRef v8_ScriptCompiler_CompileFunctionInContext(RustContext c, ContextRef context, StringRef source, int argc, StringRef arguments[]) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::TryCatch try_catch(c.isolate);
+    ContextScope context_scope(c, context);
+    v8::Local<v8::String> *arguments_wrapped = static_cast<v8::Local<v8::String>*>(alloca(sizeof(v8::Local<v8::String>) * argc));
+
+    for (int i = 0; i < argc; i++) {
+        arguments_wrapped[i] = wrap(c.isolate, arguments[i]);
+    }
+
+    v8::ScriptCompiler::Source compiler_source(wrap(c.isolate, source));
+    auto result = v8::ScriptCompiler::CompileFunctionInContext(wrap(c.isolate, context), &compiler_source, argc, arguments_wrapped, 0, nullptr);
+    handle_exception(c, try_catch);
+    return unwrap(c.isolate, result);
+}
+
 ValueRef v8_Object_CallAsFunction(RustContext c, ObjectRef self, ContextRef context, ValueRef recv, int argc, ValueRef argv[]) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
-    v8::Context::Scope context_scope(wrap(c.isolate, context));
+    ContextScope context_scope(c, context);
     v8::Local<v8::Value> *argv_wrapped = static_cast<v8::Local<v8::Value>*>(alloca(sizeof(v8::Local<v8::Value>) * argc));
     v8::Local<v8::Value> recv_wrapped;
 
@@ -991,10 +1241,10 @@ ValueRef v8_Object_CallAsFunction(RustContext c, ObjectRef self, ContextRef cont
 }
 
 ValueRef v8_Object_CallAsConstructor(RustContext c, ObjectRef self, ContextRef context, int argc, ValueRef argv[]) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
-    v8::Context::Scope context_scope(wrap(c.isolate, context));
+    ContextScope context_scope(c, context);
     v8::Local<v8::Value> *argv_wrapped = static_cast<v8::Local<v8::Value>*>(alloca(sizeof(v8::Local<v8::Value>) * argc));
 
     for (int i = 0; i < argc; i++) {
@@ -1035,6 +1285,155 @@ void function_callback(const v8::FunctionCallbackInfo<v8::Value> &info) {
     }
 }
 
+template<typename A> struct WeakFinalizer {
+    v8::Persistent<A> handle;
+    WeakFinalizerCallback callback;
+    void *parameter;
+    int64_t external_size;
+};
+
+template<typename A> void weak_finalizer_second_pass(const v8::WeakCallbackInfo<WeakFinalizer<A>> &info) {
+    WeakFinalizer<A> *finalizer = info.GetParameter();
+
+    if (finalizer->external_size) {
+        info.GetIsolate()->AdjustAmountOfExternalAllocatedMemory(-finalizer->external_size);
+    }
+
+    if (finalizer->callback) {
+        finalizer->callback(finalizer->parameter);
+    }
+
+    delete finalizer;
+}
+
+template<typename A> void weak_finalizer_first_pass(const v8::WeakCallbackInfo<WeakFinalizer<A>> &info) {
+    // Only resetting the handle is allowed in the first pass
+    info.GetParameter()->handle.Reset();
+    info.SetSecondPassCallback(weak_finalizer_second_pass<A>);
+}
+
+template<typename A> void set_weak_finalizer(
+    v8::Isolate *isolate,
+    v8::Local<A> value,
+    WeakFinalizerCallback callback,
+    void *parameter,
+    int64_t external_size) {
+    WeakFinalizer<A> *finalizer = new WeakFinalizer<A>();
+    finalizer->handle.Reset(isolate, value);
+    finalizer->callback = callback;
+    finalizer->parameter = parameter;
+    finalizer->external_size = external_size;
+
+    if (external_size) {
+        isolate->AdjustAmountOfExternalAllocatedMemory(external_size);
+    }
+
+    finalizer->handle.SetWeak(finalizer, weak_finalizer_first_pass<A>, v8::WeakCallbackType::kParameter);
+}
+
+void v8_Value_SetWeakFinalizer(
+    RustContext c,
+    ValueRef self,
+    WeakFinalizerCallback callback,
+    void *parameter,
+    int64_t external_size) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+
+    set_weak_finalizer(c.isolate, wrap(c.isolate, self), callback, parameter, external_size);
+}
+
+void v8_Context_SetWeakFinalizer(
+    RustContext c,
+    ContextRef self,
+    WeakFinalizerCallback callback,
+    void *parameter) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+
+    set_weak_finalizer(c.isolate, wrap(c.isolate, self), callback, parameter, 0);
+}
+
+EternalTemplatePtr v8_EternalTemplate_New(
+    RustContext c,
+    TemplateRef value) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+
+    return new v8::Eternal<v8::Template>(c.isolate, wrap(c.isolate, value));
+}
+
+TemplateRef v8_EternalTemplate_Get(
+    RustContext c,
+    EternalTemplatePtr self) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+
+    return unwrap(c.isolate, self->Get(c.isolate));
+}
+
+void v8_EternalTemplate_Destroy(
+    EternalTemplatePtr self) {
+    // The eternal handle itself lives as long as the isolate; this only
+    // releases our reference to it.
+    delete self;
+}
+
+struct WeakHandle {
+    v8::Persistent<v8::Value> handle;
+    WeakHandleCallback callback;
+    void *parameter;
+};
+
+void weak_handle_callback(const v8::WeakCallbackInfo<WeakHandle> &info) {
+    WeakHandle *weak = info.GetParameter();
+
+    weak->handle.Reset();
+
+    if (weak->callback) {
+        weak->callback(info.GetIsolate(), weak->parameter);
+    }
+
+    weak->parameter = nullptr;
+}
+
+WeakRef v8_Weak_New(
+    RustContext c,
+    ValueRef value,
+    WeakHandleCallback callback,
+    void *parameter) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+
+    WeakHandle *weak = new WeakHandle();
+    weak->handle.Reset(c.isolate, wrap(c.isolate, value));
+    weak->callback = callback;
+    weak->parameter = parameter;
+
+    weak->handle.SetWeak(weak, weak_handle_callback, v8::WeakCallbackType::kParameter);
+
+    return weak;
+}
+
+ValueRef v8_Weak_Get(
+    RustContext c,
+    WeakRef self) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+
+    return unwrap(c.isolate, self->handle.Get(c.isolate));
+}
+
+void *v8_Weak_Destroy(
+    WeakRef self) {
+    void *parameter = self->parameter;
+
+    self->handle.Reset();
+    delete self;
+
+    return parameter;
+}
+
 FunctionRef v8_Function_New(
     RustContext c,
     ContextRef context,
@@ -1042,7 +1441,7 @@ FunctionRef v8_Function_New(
     ValueRef data,
     int length,
     ConstructorBehavior behavior) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     v8::Local<v8::ObjectTemplate> outer_data_template =
@@ -1074,10 +1473,10 @@ ObjectRef v8_Function_NewInstance(
     ContextRef context,
     int argc,
     ValueRef argv[]) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
-    v8::Context::Scope context_scope(wrap(c.isolate, context));
+    ContextScope context_scope(c, context);
 
     v8::Local<v8::Value> *argv_wrapped = static_cast<v8::Local<v8::Value>*>(alloca(sizeof(v8::Local<v8::Value>) * argc));
 
@@ -1098,10 +1497,10 @@ ValueRef v8_Function_Call(
     ValueRef recv,
     int argc,
     ValueRef argv[]) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
-    v8::Context::Scope context_scope(wrap(c.isolate, context));
+    ContextScope context_scope(c, context);
 
     v8::Local<v8::Value> *argv_wrapped = static_cast<v8::Local<v8::Value>*>(alloca(sizeof(v8::Local<v8::Value>) * argc));
     v8::Local<v8::Value> recv_wrapped;
@@ -1122,6 +1521,537 @@ ValueRef v8_Function_Call(
     return unwrap(c.isolate, result);
 }
 
+enum class AccessorFields {
+    Getter, Setter, Data, Max
+};
+
+void accessor_getter(
+    v8::Local<v8::String> property,
+    const v8::PropertyCallbackInfo<v8::Value> &info) {
+    v8::Isolate *isolate = info.GetIsolate();
+    v8::Isolate::Scope isolate_scope(isolate);
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Object> outer_data =
+        v8::Local<v8::Object>::Cast(info.Data());
+    AccessorGetterCallback getter =
+        (AccessorGetterCallback)
+        outer_data->GetAlignedPointerFromInternalField((int) AccessorFields::Getter);
+    v8::Local<v8::Value> data = outer_data->GetInternalField((int) AccessorFields::Data);
+    PropertyCallbackInfo callback_info = build_callback_info(info, data);
+
+    getter(unwrap(isolate, property), &callback_info);
+
+    set_property_callback_result(isolate, info, callback_info);
+}
+
+void accessor_setter(
+    v8::Local<v8::String> property,
+    v8::Local<v8::Value> value,
+    const v8::PropertyCallbackInfo<void> &info) {
+    v8::Isolate *isolate = info.GetIsolate();
+    v8::Isolate::Scope isolate_scope(isolate);
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Object> outer_data =
+        v8::Local<v8::Object>::Cast(info.Data());
+    AccessorSetterCallback setter =
+        (AccessorSetterCallback)
+        outer_data->GetAlignedPointerFromInternalField((int) AccessorFields::Setter);
+    v8::Local<v8::Value> data = outer_data->GetInternalField((int) AccessorFields::Data);
+    PropertyCallbackInfo callback_info = build_callback_info(info, data);
+
+    setter(unwrap(isolate, property), unwrap(isolate, value), &callback_info);
+
+    set_property_callback_result(isolate, info, callback_info);
+}
+
+void accessor_name_getter(
+    v8::Local<v8::Name> property,
+    const v8::PropertyCallbackInfo<v8::Value> &info) {
+    v8::Isolate *isolate = info.GetIsolate();
+    v8::Isolate::Scope isolate_scope(isolate);
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Object> outer_data =
+        v8::Local<v8::Object>::Cast(info.Data());
+    AccessorNameGetterCallback getter =
+        (AccessorNameGetterCallback)
+        outer_data->GetAlignedPointerFromInternalField((int) AccessorFields::Getter);
+    v8::Local<v8::Value> data = outer_data->GetInternalField((int) AccessorFields::Data);
+    PropertyCallbackInfo callback_info = build_callback_info(info, data);
+
+    getter(unwrap(isolate, property), &callback_info);
+
+    set_property_callback_result(isolate, info, callback_info);
+}
+
+void accessor_name_setter(
+    v8::Local<v8::Name> property,
+    v8::Local<v8::Value> value,
+    const v8::PropertyCallbackInfo<void> &info) {
+    v8::Isolate *isolate = info.GetIsolate();
+    v8::Isolate::Scope isolate_scope(isolate);
+    v8::HandleScope scope(isolate);
+    v8::Local<v8::Object> outer_data =
+        v8::Local<v8::Object>::Cast(info.Data());
+    AccessorNameSetterCallback setter =
+        (AccessorNameSetterCallback)
+        outer_data->GetAlignedPointerFromInternalField((int) AccessorFields::Setter);
+    v8::Local<v8::Value> data = outer_data->GetInternalField((int) AccessorFields::Data);
+    PropertyCallbackInfo callback_info = build_callback_info(info, data);
+
+    setter(unwrap(isolate, property), unwrap(isolate, value), &callback_info);
+
+    set_property_callback_result(isolate, info, callback_info);
+}
+
+/* Returns the glue's own state for the isolate, creating it on first
+   use.  It is deleted by v8_Isolate_Dispose.
+*/
+GlueIsolateData *glue_isolate_data(v8::Isolate *isolate) {
+    auto data = (GlueIsolateData *) isolate->GetData(GLUE_DATA_SLOT);
+
+    if (!data) {
+        data = new GlueIsolateData();
+        isolate->SetData(GLUE_DATA_SLOT, data);
+    }
+
+    return data;
+}
+
+/* Creates the object that carries the wrapped accessor callbacks and
+   the user data into the accessor trampolines.  Its template is built
+   once per isolate, since accessors are installed on every new context.
+*/
+v8::Local<v8::Object> accessor_data(
+    v8::Isolate *isolate,
+    void *getter,
+    void *setter,
+    ValueRef data) {
+    GlueIsolateData *glue_data = glue_isolate_data(isolate);
+
+    if (glue_data->accessor_data_template.IsEmpty()) {
+        v8::Local<v8::ObjectTemplate> outer_data_template =
+            v8::ObjectTemplate::New(isolate);
+        outer_data_template->SetInternalFieldCount((int) AccessorFields::Max);
+        glue_data->accessor_data_template.Set(isolate, outer_data_template);
+    }
+
+    v8::Local<v8::Object> outer_data =
+        glue_data->accessor_data_template.Get(isolate)->NewInstance();
+
+    outer_data->SetAlignedPointerInInternalField((int) AccessorFields::Getter, getter);
+    outer_data->SetAlignedPointerInInternalField((int) AccessorFields::Setter, setter);
+
+    if (data) {
+        outer_data->SetInternalField((int) AccessorFields::Data, wrap(isolate, data));
+    }
+
+    return outer_data;
+}
+
+int v8_Array_GetRange(RustContext c, ArrayRef self, ContextRef context, uint32_t start, int count, ValueRef out[]) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::TryCatch try_catch(c.isolate);
+    auto context_wrapped = wrap(c.isolate, context);
+    ContextScope context_scope(c, context);
+    auto array = wrap(c.isolate, self);
+    uint32_t length = array->Length();
+    int fetched = 0;
+
+    while (fetched < count && start + fetched < length) {
+        auto value = array->Get(context_wrapped, start + fetched);
+
+        if (value.IsEmpty()) {
+            // The elements read so far are still handed out along with the exception
+            handle_exception(c, try_catch);
+            return fetched;
+        }
+
+        out[fetched++] = unwrap(c.isolate, value);
+    }
+
+    return fetched;
+}
+
+int v8_Iterator_NextValues(RustContext c, ObjectRef self, ContextRef context, int count, int arity, ValueRef out[], bool *done) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::TryCatch try_catch(c.isolate);
+    auto context_wrapped = wrap(c.isolate, context);
+    ContextScope context_scope(c, context);
+    auto iterator = wrap(c.isolate, self);
+    auto next_key = v8::String::NewFromUtf8(c.isolate, "next", v8::NewStringType::kInternalized).ToLocalChecked();
+    auto done_key = v8::String::NewFromUtf8(c.isolate, "done", v8::NewStringType::kInternalized).ToLocalChecked();
+    auto value_key = v8::String::NewFromUtf8(c.isolate, "value", v8::NewStringType::kInternalized).ToLocalChecked();
+    v8::Local<v8::Value> next;
+    int fetched = 0;
+
+    *done = false;
+
+    if (!iterator->Get(context_wrapped, next_key).ToLocal(&next) || !next->IsFunction()) {
+        if (!try_catch.HasCaught()) {
+            auto message = v8::String::NewFromUtf8(c.isolate, "iterator.next is not a function", v8::NewStringType::kNormal).ToLocalChecked();
+            c.isolate->ThrowException(v8::Exception::TypeError(message));
+        }
+        handle_exception(c, try_catch);
+        *done = true;
+        return 0;
+    }
+
+    while (fetched < count) {
+        v8::Local<v8::Value> result;
+        v8::Local<v8::Value> is_done;
+        v8::Local<v8::Value> value;
+
+        if (!next.As<v8::Function>()->Call(context_wrapped, iterator, 0, nullptr).ToLocal(&result)) {
+            break;
+        }
+
+        if (!result->IsObject()) {
+            auto message = v8::String::NewFromUtf8(c.isolate, "Iterator result is not an object", v8::NewStringType::kNormal).ToLocalChecked();
+            c.isolate->ThrowException(v8::Exception::TypeError(message));
+            break;
+        }
+
+        if (!result.As<v8::Object>()->Get(context_wrapped, done_key).ToLocal(&is_done)) {
+            break;
+        }
+
+        if (is_done->BooleanValue(context_wrapped).FromMaybe(false)) {
+            *done = true;
+            break;
+        }
+
+        if (!result.As<v8::Object>()->Get(context_wrapped, value_key).ToLocal(&value)) {
+            break;
+        }
+
+        if (arity == 1) {
+            out[fetched++] = unwrap(c.isolate, value);
+        } else {
+            // Entries come as [key, value] arrays, which are unpacked here rather than in Rust
+            if (!value->IsArray()) {
+                auto message = v8::String::NewFromUtf8(c.isolate, "Iterator value is not an entry object", v8::NewStringType::kNormal).ToLocalChecked();
+                c.isolate->ThrowException(v8::Exception::TypeError(message));
+                break;
+            }
+
+            auto entry = value.As<v8::Array>();
+            bool complete = true;
+
+            for (int i = 0; i < arity && complete; i++) {
+                v8::Local<v8::Value> element;
+                complete = entry->Get(context_wrapped, i).ToLocal(&element);
+                out[fetched * arity + i] = complete ? unwrap(c.isolate, element) : nullptr;
+            }
+
+            if (!complete) {
+                for (int i = 0; i < arity; i++) {
+                    if (out[fetched * arity + i]) {
+                        out[fetched * arity + i]->Reset();
+                        delete out[fetched * arity + i];
+                    }
+                }
+                break;
+            }
+
+            fetched++;
+        }
+    }
+
+    // Whatever stopped the iteration early, the entries read so far are still handed out
+    if (fetched < count && !*done) {
+        *done = true;
+        handle_exception(c, try_catch);
+    }
+
+    return fetched;
+}
+
+void set_iterator_item(v8::Isolate *isolate, v8::Local<v8::Value> value, IteratorItem &item) {
+    item.Number = 0.0;
+    item.Value = nullptr;
+
+    if (value->IsUndefined()) {
+        item.Primitive = PrimitiveReturnValue_Undefined;
+    } else if (value->IsNull()) {
+        item.Primitive = PrimitiveReturnValue_Null;
+    } else if (value->IsBoolean()) {
+        item.Primitive = PrimitiveReturnValue_Boolean;
+        item.Number = value->IsTrue() ? 1.0 : 0.0;
+    } else if (value->IsInt32()) {
+        item.Primitive = PrimitiveReturnValue_Int32;
+        item.Number = value.As<v8::Int32>()->Value();
+    } else if (value->IsUint32()) {
+        item.Primitive = PrimitiveReturnValue_Uint32;
+        item.Number = value.As<v8::Uint32>()->Value();
+    } else if (value->IsNumber()) {
+        item.Primitive = PrimitiveReturnValue_Number;
+        item.Number = value.As<v8::Number>()->Value();
+    } else {
+        item.Primitive = PrimitiveReturnValue_None;
+        item.Value = unwrap(isolate, value);
+    }
+}
+
+int abort_iterator_next(RustContext &c, v8::TryCatch &try_catch, int fetched) {
+    // The iterator has already moved past the items fetched so far, so
+    // they are handed out along with the exception instead of being lost
+    handle_exception(c, try_catch);
+    return fetched;
+}
+
+int v8_Iterator_Next(RustContext c, ObjectRef self, ContextRef context, int count, IteratorItem out[], bool *done) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::TryCatch try_catch(c.isolate);
+    auto context_wrapped = wrap(c.isolate, context);
+    ContextScope context_scope(c, context);
+    auto iterator = wrap(c.isolate, self);
+    auto next_key = v8::String::NewFromUtf8(c.isolate, "next", v8::NewStringType::kInternalized).ToLocalChecked();
+    auto done_key = v8::String::NewFromUtf8(c.isolate, "done", v8::NewStringType::kInternalized).ToLocalChecked();
+    auto value_key = v8::String::NewFromUtf8(c.isolate, "value", v8::NewStringType::kInternalized).ToLocalChecked();
+    v8::Local<v8::Value> next;
+    int fetched = 0;
+
+    *done = false;
+
+    if (!iterator->Get(context_wrapped, next_key).ToLocal(&next)) {
+        return abort_iterator_next(c, try_catch, fetched);
+    }
+
+    if (!next->IsFunction()) {
+        auto message = v8::String::NewFromUtf8(c.isolate, "iterator.next is not a function", v8::NewStringType::kNormal).ToLocalChecked();
+        c.isolate->ThrowException(v8::Exception::TypeError(message));
+        return abort_iterator_next(c, try_catch, fetched);
+    }
+
+    while (fetched < count) {
+        v8::Local<v8::Value> result;
+        v8::Local<v8::Value> is_done;
+        v8::Local<v8::Value> value;
+
+        if (!next.As<v8::Function>()->Call(context_wrapped, iterator, 0, nullptr).ToLocal(&result)) {
+            return abort_iterator_next(c, try_catch, fetched);
+        }
+
+        if (!result->IsObject()) {
+            auto message = v8::String::NewFromUtf8(c.isolate, "Iterator result is not an object", v8::NewStringType::kNormal).ToLocalChecked();
+            c.isolate->ThrowException(v8::Exception::TypeError(message));
+            return abort_iterator_next(c, try_catch, fetched);
+        }
+
+        if (!result.As<v8::Object>()->Get(context_wrapped, done_key).ToLocal(&is_done)) {
+            return abort_iterator_next(c, try_catch, fetched);
+        }
+
+        if (is_done->BooleanValue(context_wrapped).FromMaybe(false)) {
+            *done = true;
+            break;
+        }
+
+        if (!result.As<v8::Object>()->Get(context_wrapped, value_key).ToLocal(&value)) {
+            return abort_iterator_next(c, try_catch, fetched);
+        }
+
+        set_iterator_item(c.isolate, value, out[fetched++]);
+    }
+
+    return fetched;
+}
+
+int v8_Batch_Run(
+    RustContext c,
+    ContextRef context,
+    int count,
+    const BatchTask tasks[],
+    int argc,
+    ValueRef argv[],
+    BatchOutput output,
+    BatchResult results[],
+    BatchStringSink sink,
+    void *sink_data) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    ContextScope context_scope(c, context);
+    auto context_wrapped = wrap(c.isolate, context);
+    v8::Local<v8::Value> *argv_wrapped = static_cast<v8::Local<v8::Value>*>(alloca(sizeof(v8::Local<v8::Value>) * argc));
+    auto recv = v8::Undefined(c.isolate);
+    size_t string_offset = 0;
+
+    for (int i = 0; i < argc; i++) {
+        argv_wrapped[i] = wrap(c.isolate, argv[i]);
+    }
+
+    for (int i = 0; i < count; i++) {
+        v8::HandleScope item_scope(c.isolate);
+        v8::TryCatch try_catch(c.isolate);
+        BatchResult &result = results[i];
+        v8::MaybeLocal<v8::Value> maybe_value;
+        v8::Local<v8::Value> value;
+        bool ok = false;
+
+        result.exception = nullptr;
+        result.boolean = false;
+        result.number = 0.0;
+        result.string_offset = 0;
+        result.string_length = 0;
+
+        if (tasks[i].script) {
+            maybe_value = wrap(c.isolate, tasks[i].script)->Run(context_wrapped);
+        } else {
+            maybe_value = wrap(c.isolate, tasks[i].function)->Call(context_wrapped, recv, argc, argv_wrapped);
+        }
+
+        if (maybe_value.ToLocal(&value)) {
+            switch (output) {
+            case BatchOutput_Discard:
+                ok = true;
+                break;
+            case BatchOutput_Boolean:
+                ok = value->BooleanValue(context_wrapped).To(&result.boolean);
+                break;
+            case BatchOutput_Number:
+                ok = value->NumberValue(context_wrapped).To(&result.number);
+                break;
+            case BatchOutput_String: {
+                v8::Local<v8::String> string;
+
+                if (value->ToString(context_wrapped).ToLocal(&string)) {
+                    v8::String::Utf8Value utf8(string);
+                    result.string_offset = string_offset;
+                    result.string_length = utf8.length();
+                    sink(sink_data, *utf8, result.string_length);
+                    string_offset += result.string_length;
+                    ok = true;
+                }
+                break;
+            }
+            }
+        }
+
+        if (!ok && try_catch.HasCaught()) {
+            result.exception = unwrap(c.isolate, try_catch.Exception());
+
+            if (!try_catch.CanContinue()) {
+                // Execution is being terminated, so the remaining tasks can't run
+                return i + 1;
+            }
+        } else if (!ok) {
+            // The task failed without throwing, which V8 only does when it
+            // can't run script at all, so the remaining tasks would too
+            result.exception = unwrap(c.isolate, v8::Undefined(c.isolate));
+            return i + 1;
+        }
+    }
+
+    return count;
+}
+
+ArrayBufferRef v8_ArrayBuffer_New_Copy(RustContext c, const void *data, size_t byte_length) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::Local<v8::ArrayBuffer> result = v8::ArrayBuffer::New(c.isolate, byte_length);
+
+    if (byte_length > 0) {
+        memcpy(result->GetContents().Data(), data, byte_length);
+    }
+
+    return unwrap(c.isolate, result);
+}
+
+ArrayBufferRef v8_ArrayBuffer_New_Internalized(RustContext c, void *data, size_t byte_length) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    auto result = v8::ArrayBuffer::New(c.isolate, data, byte_length, v8::ArrayBufferCreationMode::kInternalized);
+    return unwrap(c.isolate, result);
+}
+
+void *v8_ArrayBuffer_GetContents_Data(RustContext c, ArrayBufferRef self, size_t *byte_length) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::ArrayBuffer::Contents contents = wrap(c.isolate, self)->GetContents();
+    *byte_length = contents.ByteLength();
+    return contents.Data();
+}
+
+bool v8_ArrayBuffer_IsDetachable(RustContext c, ArrayBufferRef self) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::Local<v8::ArrayBuffer> buffer = wrap(c.isolate, self);
+
+    // An external buffer's memory is owned by someone else, so it can't be handed over
+    return !buffer->IsExternal() && buffer->IsNeuterable();
+}
+
+bool v8_ArrayBuffer_Detach(RustContext c, ArrayBufferRef self, void **data, size_t *byte_length) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::Local<v8::ArrayBuffer> buffer = wrap(c.isolate, self);
+
+    if (buffer->IsExternal() || !buffer->IsNeuterable()) {
+        return false;
+    }
+
+    v8::ArrayBuffer::Contents contents = buffer->Externalize();
+    buffer->Neuter();
+    *data = contents.Data();
+    *byte_length = contents.ByteLength();
+    return true;
+}
+
+void v8_WasmCompiledModule_Serialize(RustContext c, WasmCompiledModuleRef self, WasmBytesSink sink, void *sink_data) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::WasmCompiledModule::SerializedModule serialized = wrap(c.isolate, self)->Serialize();
+    sink(sink_data, serialized.first.get(), serialized.second);
+}
+
+WasmCompiledModuleRef v8_WasmCompiledModule_Deserialize(RustContext c, const uint8_t *data, size_t length) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::TryCatch try_catch(c.isolate);
+
+    // V8 takes ownership of the serialized bytes
+    uint8_t *copy = new uint8_t[length];
+    memcpy(copy, data, length);
+    v8::WasmCompiledModule::SerializedModule serialized(std::unique_ptr<const uint8_t[]>(copy), length);
+
+    auto result = v8::WasmCompiledModule::Deserialize(c.isolate, std::move(serialized));
+    handle_exception(c, try_catch);
+    return unwrap(c.isolate, result);
+}
+
+MaybeBool v8_Object_SetAccessor_Name(
+    RustContext c,
+    ObjectRef self,
+    ContextRef context,
+    NameRef name,
+    AccessorNameGetterCallback getter,
+    AccessorNameSetterCallback setter,
+    ValueRef data,
+    AccessControl settings,
+    PropertyAttribute attribute) {
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::TryCatch try_catch(c.isolate);
+    ContextScope context_scope(c, context);
+    v8::Local<v8::Object> outer_data =
+        accessor_data(c.isolate, (void *) getter, (void *) setter, data);
+
+    auto result = wrap(c.isolate, self)->SetAccessor(
+        wrap(c.isolate, context),
+        wrap(c.isolate, name),
+        getter ? accessor_name_getter : nullptr,
+        setter ? accessor_name_setter : nullptr,
+        outer_data,
+        wrap(c.isolate, settings),
+        wrap(c.isolate, attribute));
+
+    handle_exception(c, try_catch);
+    return unwrap_maybe_bool(c.isolate, result);
+}
+
 void v8_Template_SetNativeDataProperty(
     RustContext c,
     TemplateRef self,
@@ -1132,9 +2062,48 @@ void v8_Template_SetNativeDataProperty(
     PropertyAttribute attribute,
     AccessorSignatureRef signature,
     AccessControl settings) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
+    v8::HandleScope scope(c.isolate);
+    v8::TryCatch try_catch(c.isolate);
+    v8::Local<v8::Object> outer_data =
+        accessor_data(c.isolate, (void *) getter, (void *) setter, data);
+
+    wrap(c.isolate, self)->SetNativeDataProperty(
+        wrap(c.isolate, name),
+        getter ? accessor_getter : nullptr,
+        setter ? accessor_setter : nullptr,
+        outer_data,
+        wrap(c.isolate, attribute),
+        wrap(c.isolate, signature),
+        wrap(c.isolate, settings));
+
+    handle_exception(c, try_catch);
+}
+
+void v8_Template_SetNativeDataProperty_Name(
+    RustContext c,
+    TemplateRef self,
+    NameRef name,
+    AccessorNameGetterCallback getter,
+    AccessorNameSetterCallback setter,
+    ValueRef data,
+    PropertyAttribute attribute,
+    AccessorSignatureRef signature,
+    AccessControl settings) {
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
+    v8::Local<v8::Object> outer_data =
+        accessor_data(c.isolate, (void *) getter, (void *) setter, data);
+
+    wrap(c.isolate, self)->SetNativeDataProperty(
+        wrap(c.isolate, name),
+        getter ? accessor_name_getter : nullptr,
+        setter ? accessor_name_setter : nullptr,
+        outer_data,
+        wrap(c.isolate, attribute),
+        wrap(c.isolate, signature),
+        wrap(c.isolate, settings));
 
     handle_exception(c, try_catch);
 }
@@ -1147,7 +2116,7 @@ FunctionTemplateRef v8_FunctionTemplate_New(
     SignatureRef signature,
     int length,
     ConstructorBehavior behavior) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
     v8::Local<v8::ObjectTemplate> outer_data_template =
@@ -1181,9 +2150,20 @@ void v8_ObjectTemplate_SetAccessor(
     AccessControl settings,
     PropertyAttribute attribute,
     AccessorSignatureRef signature) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
+    v8::Local<v8::Object> outer_data =
+        accessor_data(c.isolate, (void *) getter, (void *) setter, data);
+
+    wrap(c.isolate, self)->SetAccessor(
+        wrap(c.isolate, name),
+        getter ? accessor_getter : nullptr,
+        setter ? accessor_setter : nullptr,
+        outer_data,
+        wrap(c.isolate, settings),
+        wrap(c.isolate, attribute),
+        wrap(c.isolate, signature));
 
     handle_exception(c, try_catch);
 }
@@ -1191,16 +2171,27 @@ void v8_ObjectTemplate_SetAccessor(
 void v8_ObjectTemplate_SetAccessor_Name(
     RustContext c,
     ObjectTemplateRef self,
-    StringRef name,
+    NameRef name,
     AccessorNameGetterCallback getter,
     AccessorNameSetterCallback setter,
     ValueRef data,
     AccessControl settings,
     PropertyAttribute attribute,
     AccessorSignatureRef signature) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
+    v8::Local<v8::Object> outer_data =
+        accessor_data(c.isolate, (void *) getter, (void *) setter, data);
+
+    wrap(c.isolate, self)->SetAccessor(
+        wrap(c.isolate, name),
+        getter ? accessor_name_getter : nullptr,
+        setter ? accessor_name_setter : nullptr,
+        outer_data,
+        wrap(c.isolate, settings),
+        wrap(c.isolate, attribute),
+        wrap(c.isolate, signature));
 
     handle_exception(c, try_catch);
 }
@@ -1210,7 +2201,7 @@ void v8_ObjectTemplate_SetCallAsFunctionHandler(
     ObjectTemplateRef self,
     FunctionCallback callback,
     ValueRef data) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
 
@@ -1222,7 +2213,7 @@ void v8_ObjectTemplate_SetAccessCheckCallback(
     ObjectTemplateRef self,
     AccessCheckCallback callback,
     ValueRef data) {
-    v8::Isolate::Scope isolate_scope(c.isolate);
+    IsolateScope isolate_scope(c);
     v8::HandleScope scope(c.isolate);
     v8::TryCatch try_catch(c.isolate);
 
@@ -68,6 +68,12 @@ typedef v8::IdleTask *IdleTaskPtr;
 typedef struct _IdleTask *IdleTaskPtr;
 #endif /* defined __cplusplus */
 
+#if defined __cplusplus
+typedef v8::Eternal<v8::Template> *EternalTemplatePtr;
+#else
+typedef struct _EternalTemplate *EternalTemplatePtr;
+#endif /* defined __cplusplus */
+
 /* Special structs simulating vtables */
 struct v8_AllocatorFunctions {
     void *(*Allocate)(size_t length);
@@ -169,6 +175,21 @@ enum Intrinsic {
 };
 typedef enum Intrinsic Intrinsic;
 
+/* Primitive values that callbacks can return without allocating a
+   handle.  `ReturnNumber` holds the payload for the boolean and
+   numeric variants.
+*/
+enum PrimitiveReturnValue {
+    PrimitiveReturnValue_None,
+    PrimitiveReturnValue_Undefined,
+    PrimitiveReturnValue_Null,
+    PrimitiveReturnValue_Boolean,
+    PrimitiveReturnValue_Int32,
+    PrimitiveReturnValue_Uint32,
+    PrimitiveReturnValue_Number
+};
+typedef enum PrimitiveReturnValue PrimitiveReturnValue;
+
 enum ArrayBufferCreationMode {
     ArrayBufferCreationMode_kInternalized,
     ArrayBufferCreationMode_kExternalized
@@ -186,6 +207,8 @@ struct PropertyCallbackInfo {
     ValueRef ReturnValue;
     bool ShouldThrowOnError;
     ValueRef ThrownValue;
+    PrimitiveReturnValue ReturnPrimitive;
+    double ReturnNumber;
 };
 
 struct FunctionCallbackInfo {
@@ -201,6 +224,62 @@ struct FunctionCallbackInfo {
     ValueRef ThrownValue;
 };
 
+/* An item produced by a Javascript iterator.  Primitives are returned
+   inline, like the `ReturnPrimitive` of property callbacks; for all
+   other values, `Primitive` is `PrimitiveReturnValue_None` and `Value`
+   holds a handle.
+*/
+struct IteratorItem {
+    PrimitiveReturnValue Primitive;
+    double Number;
+    ValueRef Value;
+};
+typedef struct IteratorItem IteratorItem;
+
+/* How `v8_Batch_Run` should convert the result of each task. */
+enum BatchOutput {
+    BatchOutput_Discard,
+    BatchOutput_Boolean,
+    BatchOutput_Number,
+    BatchOutput_String
+};
+typedef enum BatchOutput BatchOutput;
+
+/* A task of `v8_Batch_Run`: either a script to run, or a function to
+   call with the arguments of the batch.  Exactly one must be set.
+*/
+struct BatchTask {
+    ScriptRef script;
+    FunctionRef function;
+};
+typedef struct BatchTask BatchTask;
+
+/* The result of a task of `v8_Batch_Run`.  If the task threw,
+   `exception` holds the thrown value and the other fields are unset;
+   a task that failed without throwing gets `undefined` as exception.
+   String results are appended to the string sink of the batch, and
+   located by `string_offset` and `string_length`.
+*/
+struct BatchResult {
+    ValueRef exception;
+    bool boolean;
+    double number;
+    size_t string_offset;
+    size_t string_length;
+};
+typedef struct BatchResult BatchResult;
+
+typedef void (*BatchStringSink)(void *sink, const char *data, size_t length);
+
+/* Receives the bytes of a serialized WebAssembly module, which are
+   only valid for the duration of the call.
+*/
+typedef void (*WasmBytesSink)(void *sink, const uint8_t *data, size_t length);
+
+/* Runs or frees the Rust closure of a task created with `v8_Task_New`.
+*/
+typedef void (*TaskCallback)(void *data);
+
 /* These typedefs are just here to give a nicer hint to the user as to
    which type of return value is expected to be set.  For the `Void`
    variant, the SetReturnValue function should not be called.
@@ -213,6 +292,22 @@ typedef struct PropertyCallbackInfo *PropertyCallbackInfoPtr_Integer;
 typedef struct PropertyCallbackInfo *PropertyCallbackInfoPtr_Array;
 typedef struct FunctionCallbackInfo *FunctionCallbackInfoPtr_Value;
 
+/* Called once the object a weak finalizer was attached to has been
+   garbage collected.  Runs in the second pass of the GC weak callbacks,
+   so V8 API calls (such as releasing other handles) are allowed.
+*/
+typedef void (*WeakFinalizerCallback)(void *parameter);
+
+/* A weak handle to a value, which does not keep the value alive.  Once
+   the value has been garbage collected, the handle becomes empty and
+   its callback is invoked in the first pass of the GC weak callbacks,
+   so the callback must not call into V8.
+*/
+struct WeakHandle;
+typedef struct WeakHandle *WeakRef;
+
+typedef void (*WeakHandleCallback)(IsolatePtr isolate, void *parameter);
+
 typedef void (*AccessorGetterCallback)(
     StringRef property,
     PropertyCallbackInfoPtr_Value info);
@@ -333,6 +428,7 @@ typedef struct IndexedPropertyHandlerConfiguration IndexedPropertyHandlerConfigu
 PlatformPtr v8_Platform_Create(v8_PlatformFunctions platform_functions);
 void v8_Platform_Destroy(PlatformPtr platform);
 
+TaskPtr v8_Task_New(TaskCallback run, TaskCallback destroy, void *data);
 void v8_Task_Destroy(TaskPtr task);
 void v8_IdleTask_Destroy(IdleTaskPtr task);
 
@@ -341,6 +437,7 @@ void v8_V8_InitializePlatform(PlatformPtr platform);
 void v8_V8_Initialize();
 void v8_V8_Dispose();
 void v8_V8_ShutdownPlatform();
+void v8_V8_SetFlagsFromString(const char *flags, int length);
 
 
 ArrayBuffer_AllocatorPtr v8_ArrayBuffer_Allocator_Create(v8_AllocatorFunctions allocator_functions);
@@ -354,6 +451,12 @@ void v8_Isolate_SetData(IsolatePtr self, uint32_t slot, void *data);
 void *v8_Isolate_GetData(IsolatePtr self, uint32_t slot);
 void v8_Isolate_SetCaptureStackTraceForUncaughtExceptions_Overview(IsolatePtr self, bool capture, int frame_limit);
 void v8_Isolate_SetCaptureStackTraceForUncaughtExceptions_Detailed(IsolatePtr self, bool capture, int frame_limit);
+int64_t v8_Isolate_AdjustAmountOfExternalAllocatedMemory(IsolatePtr self, int64_t change_in_bytes);
+void v8_Isolate_LowMemoryNotification(IsolatePtr self);
+void v8_Isolate_Enter(IsolatePtr self);
+void v8_Isolate_Exit(IsolatePtr self);
+void v8_Isolate_TerminateExecution(IsolatePtr self);
+void *v8_Isolate_GetCurrentContextAlignedPointer(IsolatePtr self, int index);
 void v8_Isolate_Dispose(IsolatePtr isolate);
 
 void v8_Task_Run(TaskPtr task);
@@ -367,6 +470,14 @@ BooleanRef v8_True(RustContext c);
 BooleanRef v8_False(RustContext c);
 
 ContextRef v8_Context_New(RustContext c);
+ContextRef v8_Context_New_GlobalTemplate(RustContext c, ObjectTemplateRef global_template);
+
+/* Describes how small integers (Smis) are tagged in this build of V8, so
+   that they can be read straight out of handles without calling into V8.
+   A tagged word holds a Smi if its low `tag_size` bits equal `tag`; the
+   value is then the word shifted right by `tag_size + shift_size` bits.
+*/
+void v8_Smi_Layout(int *tag, int *tag_size, int *shift_size);
 
 StringRef v8_String_NewFromUtf8_Normal(RustContext c, const char *data, int length);
 StringRef v8_String_NewFromUtf8_Internalized(RustContext c, const char *data, int length);
@@ -376,27 +487,75 @@ int v8_String_WriteUtf8(RustContext c, StringRef string, char *buffer, int lengt
 ScriptRef v8_Script_Compile(RustContext c, ContextRef context, StringRef source);
 ScriptRef v8_Script_Compile_Origin(RustContext c, ContextRef context, StringRef source, ValueRef resource_name, IntegerRef resource_line_offset, IntegerRef resource_column_offset, BooleanRef resource_is_shared_cross_origin, IntegerRef script_id, BooleanRef resource_is_embedder_debug_script, ValueRef source_map_url, BooleanRef resource_is_opaque);
 
+FunctionRef v8_ScriptCompiler_CompileFunctionInContext(RustContext c, ContextRef context, StringRef source, int argc, StringRef arguments[]);
+
 ValueRef v8_Object_CallAsFunction(RustContext c, ObjectRef self, ContextRef context, ValueRef recv, int argc, ValueRef argv[]);
 
 ValueRef v8_Object_CallAsConstructor(RustContext c, ObjectRef self, ContextRef context, int argc, ValueRef argv[]);
 
+int v8_Array_GetRange(RustContext c, ArrayRef self, ContextRef context, uint32_t start, int count, ValueRef out[]);
+
+int v8_Iterator_Next(RustContext c, ObjectRef self, ContextRef context, int count, IteratorItem out[], bool *done);
+
+int v8_Iterator_NextValues(RustContext c, ObjectRef self, ContextRef context, int count, int arity, ValueRef out[], bool *done);
+
+int v8_Batch_Run(RustContext c, ContextRef context, int count, const BatchTask tasks[], int argc, ValueRef argv[], BatchOutput output, BatchResult results[], BatchStringSink sink, void *sink_data);
+
+ArrayBufferRef v8_ArrayBuffer_New_Copy(RustContext c, const void *data, size_t byte_length);
+ArrayBufferRef v8_ArrayBuffer_New_Internalized(RustContext c, void *data, size_t byte_length);
+void *v8_ArrayBuffer_GetContents_Data(RustContext c, ArrayBufferRef self, size_t *byte_length);
+bool v8_ArrayBuffer_IsDetachable(RustContext c, ArrayBufferRef self);
+bool v8_ArrayBuffer_Detach(RustContext c, ArrayBufferRef self, void **data, size_t *byte_length);
+
+void v8_WasmCompiledModule_Serialize(RustContext c, WasmCompiledModuleRef self, WasmBytesSink sink, void *sink_data);
+WasmCompiledModuleRef v8_WasmCompiledModule_Deserialize(RustContext c, const uint8_t *data, size_t length);
+
+MaybeBool v8_Object_SetAccessor_Name(RustContext c, ObjectRef self, ContextRef context, NameRef name, AccessorNameGetterCallback getter, AccessorNameSetterCallback setter, ValueRef data, AccessControl settings, PropertyAttribute attribute);
+
+/* Invokes the callback (if any) once the value has been collected.  A
+   non-zero external size is reported to V8 as externally allocated
+   memory for as long as the value is alive.
+*/
+void v8_Value_SetWeakFinalizer(RustContext c, ValueRef self, WeakFinalizerCallback callback, void *parameter, int64_t external_size);
+void v8_Context_SetWeakFinalizer(RustContext c, ContextRef self, WeakFinalizerCallback callback, void *parameter);
+
+EternalTemplatePtr v8_EternalTemplate_New(RustContext c, TemplateRef value);
+TemplateRef v8_EternalTemplate_Get(RustContext c, EternalTemplatePtr self);
+void v8_EternalTemplate_Destroy(EternalTemplatePtr self);
+
+WeakRef v8_Weak_New(RustContext c, ValueRef value, WeakHandleCallback callback, void *parameter);
+ValueRef v8_Weak_Get(RustContext c, WeakRef self);
+/* Returns the callback parameter if the callback has not been invoked yet */
+void *v8_Weak_Destroy(WeakRef self);
+
 FunctionRef v8_Function_New(RustContext c, ContextRef context, FunctionCallback callback, ValueRef data, int length, ConstructorBehavior behavior);
 ObjectRef v8_Function_NewInstance(RustContext c, FunctionRef self, ContextRef context, int argc, ValueRef argv[]);
 ValueRef v8_Function_Call(RustContext c, FunctionRef self, ContextRef context, ValueRef recv, int argc, ValueRef argv[]);
 
 void v8_Template_SetNativeDataProperty(RustContext c, TemplateRef self, StringRef name, AccessorGetterCallback getter, AccessorSetterCallback setter, ValueRef data, PropertyAttribute attribute, AccessorSignatureRef signature, AccessControl settings);
+void v8_Template_SetNativeDataProperty_Name(RustContext c, TemplateRef self, NameRef name, AccessorNameGetterCallback getter, AccessorNameSetterCallback setter, ValueRef data, PropertyAttribute attribute, AccessorSignatureRef signature, AccessControl settings);
 
 FunctionTemplateRef v8_FunctionTemplate_New(RustContext c, ContextRef context, FunctionCallback wrapped_callback, ValueRef data, SignatureRef signature, int length, ConstructorBehavior behavior);
 
 void v8_ObjectTemplate_SetAccessor(RustContext c, ObjectTemplateRef self, StringRef name, AccessorGetterCallback getter, AccessorSetterCallback setter, ValueRef data, AccessControl settings, PropertyAttribute attribute, AccessorSignatureRef signature);
-void v8_ObjectTemplate_SetAccessor_Name(RustContext c, ObjectTemplateRef self, StringRef name, AccessorNameGetterCallback getter, AccessorNameSetterCallback setter, ValueRef data, AccessControl settings, PropertyAttribute attribute, AccessorSignatureRef signature);
+void v8_ObjectTemplate_SetAccessor_Name(RustContext c, ObjectTemplateRef self, NameRef name, AccessorNameGetterCallback getter, AccessorNameSetterCallback setter, ValueRef data, AccessControl settings, PropertyAttribute attribute, AccessorSignatureRef signature);
 void v8_ObjectTemplate_SetCallAsFunctionHandler(RustContext c, ObjectTemplateRef self, FunctionCallback callback, ValueRef data);
 void v8_ObjectTemplate_SetAccessCheckCallback(RustContext c, ObjectTemplateRef self, AccessCheckCallback callback, ValueRef data);
 
+/* The isolate of a call, and where to put any exception it throws.
+
+   `isolate_entered` tells the glue that the caller has already entered
+   the isolate, so that the glue can skip entering it again.
+   `context_entered` tells it that the context passed to the call is
+   already the isolate's current context, so that the glue can skip
+   entering it again.
+*/
 struct RustContext {
     IsolatePtr isolate;
     ValueRef *exception;
     MessageRef *message;
+    bool isolate_entered;
+    bool context_entered;
 };
 
 #if defined __cplusplus